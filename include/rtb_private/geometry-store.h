@@ -0,0 +1,85 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <rutabaga/geometry.h>
+#include <rutabaga/element.h>
+
+/**
+ * a packed, per-window mirror of every attached element's rect,
+ * visibility and place in the tree, so that the traversals that only
+ * need geometry can walk flat arrays instead of chasing element pointers.
+ *
+ * elements are given a slot when they're attached, give it back when
+ * they're detached, and write their geometry into it at the end of each
+ * reflow. slot 0 is never used, so that a zero slot or link means none.
+ * children are linked in the same order as the element tree's.
+ *
+ * slots with a lot of children also get a uniform grid over their
+ * children's rects, so that hit-testing doesn't have to look at every
+ * one of them. a grid goes stale whenever one of the children moves, and
+ * is rebuilt the next time it's queried.
+ */
+
+struct rtb_child_grid;
+
+struct rtb_geometry_store {
+	unsigned int size;
+	unsigned int capacity;
+	unsigned int free_slot;
+
+	float *x;
+	float *y;
+	float *x2;
+	float *y2;
+	unsigned char *visibility;
+
+	unsigned int *parent;
+	unsigned int *first_child;
+	unsigned int *last_child;
+	unsigned int *prev_sibling;
+	unsigned int *next_sibling;
+	unsigned int *child_count;
+
+	struct rtb_child_grid **grid;
+	struct rtb_element **element;
+};
+
+struct rtb_geometry_store *rtb_geometry_store_new(void);
+void rtb_geometry_store_free(struct rtb_geometry_store *);
+
+int rtb_geometry_store_attach(struct rtb_geometry_store *,
+		struct rtb_element *);
+void rtb_geometry_store_detach(struct rtb_geometry_store *,
+		struct rtb_element *);
+void rtb_geometry_store_sync(struct rtb_geometry_store *,
+		struct rtb_element *);
+
+/* the topmost child of `slot` under `pt` that isn't fully obscured, or
+ * 0 if there isn't one. */
+unsigned int rtb_geometry_store_child_at(struct rtb_geometry_store *,
+		unsigned int slot, struct rtb_point pt);
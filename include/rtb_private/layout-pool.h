@@ -0,0 +1,69 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <uv.h>
+#include <rutabaga/element.h>
+
+/**
+ * a small pool of worker threads for laying out independent subtrees.
+ * only geometry is computed on the workers -- everything that touches GL
+ * still happens in the reflow pass afterwards, on the main thread.
+ */
+
+typedef void (*rtb_layout_job_t)(struct rtb_element *);
+
+struct rtb_layout_pool {
+	uv_mutex_t lock;
+	uv_cond_t work_ready;
+	uv_cond_t work_done;
+
+	uv_thread_t *threads;
+	int nthreads;
+	int shutting_down;
+
+	/* the batch being worked on */
+	rtb_layout_job_t job;
+	struct rtb_element **subtrees;
+	size_t nsubtrees;
+	size_t next_subtree;
+	size_t subtrees_done;
+};
+
+/* returns NULL if there's only one core to run on. */
+struct rtb_layout_pool *rtb_layout_pool_new(void);
+void rtb_layout_pool_free(struct rtb_layout_pool *);
+
+/* lays out the geometry of the whole tree under `root`, marking every
+ * element it gets to with RTB_REFLOW_LAID_OUT so that the reflow pass
+ * that follows doesn't do it again. */
+void rtb_layout_pool_lay_out(struct rtb_layout_pool *,
+		struct rtb_element *root);
+
+/* in element.c */
+void rtb_elem_layout_geometry(struct rtb_element *);
@@ -28,13 +28,27 @@
 
 #include <rutabaga/rutabaga.h>
 #include <rutabaga/types.h>
-#include <rutabaga/dict.h>
 
 #define RTB_ATOM(x) RTB_UPCAST(x, rtb_atom)
 #define RTB_TYPE_ATOM(x) RTB_UPCAST(x, rtb_type_atom)
 
 #define RTB_ATOM_DESCRIPTOR(x) RTB_UPCAST(x, rtb_atom_descriptor)
 
+/* deep enough for any widget hierarchy we'd reasonably build. */
+#define RTB_TYPE_MAX_DEPTH 16
+
+/* for declaring a type's descriptor statically:
+ *
+ *     static struct rtb_type_atom_descriptor knob_type =
+ *         RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.knob");
+ *
+ * it gets its id and ancestry the first time it's passed to
+ * rtb_type_register(). */
+#define RTB_TYPE_DESCRIPTOR(type_name) {.name = type_name}
+
+#define RTB_TYPE_SUPER(type) \
+	((type)->depth ? (type)->ancestors[(type)->depth - 1] : NULL)
+
 typedef enum {
 	RTB_TYPE_ATOM
 } rtb_atom_metatype_t;
@@ -50,28 +64,46 @@ struct rtb_type_atom {
 
 struct rtb_atom_descriptor {
 	const char *name;
-	int ref_count;
-
-	void *dict;
-	RTB_DICT_ENTRY(rtb_atom_descriptor) dict_entry;
 };
 
 struct rtb_type_atom_descriptor {
 	RTB_INHERIT(rtb_atom_descriptor);
-	struct rtb_type_atom_descriptor *super[0];
+
+	/* private ********************************/
+	/* assigned on registration, unique per process and never 0 for a
+	 * registered type. */
+	unsigned int id;
+
+	/* ancestors[0] is the root type, ancestors[depth] is this one. */
+	unsigned int depth;
+	struct rtb_type_atom_descriptor *ancestors[RTB_TYPE_MAX_DEPTH];
+
+	uint32_t style_hash;
 };
 
 /**
  * public API
  */
 
-struct rtb_window;
+/* linear in the number of registered types, so keep it off hot paths. */
+struct rtb_type_atom_descriptor *rtb_type_lookup(const char *type_name);
+struct rtb_type_atom_descriptor *rtb_type_by_id(unsigned int id);
+
+/* every registered id is below this. */
+unsigned int rtb_type_count(void);
+
+static inline int
+rtb_is_type(struct rtb_type_atom_descriptor *desc,
+		struct rtb_type_atom *atom)
+{
+	struct rtb_type_atom_descriptor *type = atom->type;
 
-struct rtb_type_atom_descriptor *rtb_type_lookup(
-		struct rtb_window *win, const char *type_name);
-int rtb_is_type(struct rtb_type_atom_descriptor *desc,
-		struct rtb_type_atom *atom);
+	return type && type->depth >= desc->depth
+		&& type->ancestors[desc->depth] == desc;
+}
 
-struct rtb_type_atom_descriptor *rtb_type_ref(struct rtb_window *win,
-		struct rtb_type_atom_descriptor *super, const char *type_name);
-int rtb_type_unref(struct rtb_type_atom_descriptor *type);
+/* registers `type` as a subtype of `super` (NULL for a root type) the
+ * first time it's called, and just returns `type` after that. */
+struct rtb_type_atom_descriptor *rtb_type_register(
+		struct rtb_type_atom_descriptor *type,
+		struct rtb_type_atom_descriptor *super);
@@ -46,15 +46,49 @@ struct rtb_element;
 #define RTB_SUBCLASS(self, init_func, copy_impl_to) ({						\
 	int ret;																\
 	if (!(ret = init_func(self)))											\
-		*copy_impl_to = self->impl;											\
+		*copy_impl_to = *self->impl;										\
 	ret;})
 
 typedef enum {
 	RTB_ELEM_NO_FOCUS           = 0,
 	RTB_ELEM_CLICK_FOCUS        = 0x01,
-	RTB_ELEM_TAB_FOCUS          = 0x02
+	RTB_ELEM_TAB_FOCUS          = 0x02,
+
+	/* the element's size doesn't depend on what's inside it, so a
+	 * reflow coming up from one of its descendants stops here. */
+	RTB_ELEM_LAYOUT_ROOT        = 0x04
 } rtb_elem_flags_t;
 
+/* for the flex and grid layouts, see layout.h */
+struct rtb_layout_params {
+	/* as the child of a flex container. a basis below 0 means the
+	 * child's measured size. grow also stretches a grid child to fill
+	 * its cell. */
+	float grow;
+	float shrink;
+	float basis;
+
+	/* as a flex or grid container */
+	int wrap;
+	int columns;
+};
+
+#define RTB_INLINE_HANDLERS 2
+
+/* private. see rtb_elem_trigger_reflow(). */
+typedef enum {
+	RTB_REFLOW_QUEUED           = 0x01,
+	RTB_REFLOW_LEAFWARD         = 0x02,
+	RTB_REFLOW_ROOTWARD         = 0x04,
+	RTB_REFLOW_LAID_OUT         = 0x08
+} rtb_elem_reflow_pending_t;
+
+/* private. see rtb_elem_begin_mutation(). */
+typedef enum {
+	RTB_MUTATION_ATTACHED       = 0x01,
+	RTB_MUTATION_DETACHED       = 0x02
+} rtb_elem_mutation_pending_t;
+
 typedef enum {
 	RTB_STATE_UNATTACHED = 0,
 
@@ -115,21 +149,6 @@ struct rtb_element_implementation {
 	rtb_elem_cb_internal_event_t on_event;
 
 
-	/**
-	 * rtb_element_implementation.size_cb
-	 *
-	 * called when the element should report its desired size.
-	 */
-	rtb_elem_cb_size_t size_cb;
-
-	/**
-	 * rtb_element_implementation.layout_cb
-	 *
-	 * called when the element should layout its children.
-	 */
-	rtb_elem_cb_t layout_cb;
-
-
 	/**
 	 * rtb_element_implementation.attached
 	 *
@@ -213,26 +232,131 @@ struct rtb_element_event {
 struct rtb_element {
 	RTB_INHERIT(rtb_type_atom);
 
+	/* everything up to the stylequad is touched on every draw and tree
+	 * walk, and is kept together at the front. the rest is only needed
+	 * for restyles, reflows and events. */
+
 	/* public *********************************/
 	RTB_INHERIT_AS(rtb_rect, rect);
 	rtb_elem_flags_t flags;
 
-	RTB_INHERIT_AS(rtb_element_implementation, impl);
+	/* shared between every element of the same class. */
+	const struct rtb_element_implementation *impl;
+
+	/**
+	 * called when the element should report its desired size.
+	 *
+	 * like layout_cb, this can be called from a layout worker thread, so
+	 * it mustn't touch GL or anything outside the element's subtree.
+	 */
+	rtb_elem_cb_size_t size_cb;
+
+	/**
+	 * called when the element should layout its children.
+	 *
+	 * during a window-wide reflow, sibling subtrees are laid out in
+	 * parallel (see rtb_window_flush_reflow()). only set the position and
+	 * size of children here, and leave GL work to reflow.
+	 */
+	rtb_elem_cb_t layout_cb;
+
+	TAILQ_HEAD(children, rtb_element) children;
+
+	/* private ********************************/
+	rtb_elem_state_t state;
+	rtb_visibility_t visibility;
+
+	/* the part of rect that isn't clipped away by an ancestor or by the
+	 * surface. worked out on reflow, which sets clip_visibility from it.
+	 * that's kept apart from visibility (which is whatever was passed to
+	 * rtb_elem_set_visibility()), see rtb_elem_visibility(). */
+	struct rtb_rect clip_rect;
+	rtb_visibility_t clip_visibility;
+
+	struct rtb_element *parent;
+	struct rtb_window  *window;
+	struct rtb_surface *surface;
+
+	/* this element's slot in its window's geometry store. 0 while the
+	 * element isn't attached. */
+	unsigned int geometry_slot;
+
+	/* what rtb_elem_mark_dirty() would otherwise have to walk rootward
+	 * for, kept up to date on attach, restyle and visibility changes.
+	 * opaque_ancestor is the outermost ancestor inside our surface that
+	 * has a background colour, or NULL. effectively_visible is 0 if we,
+	 * an ancestor or our surface are fully obscured. */
+	struct rtb_element *opaque_ancestor;
+	int effectively_visible;
+
+	/* opaque is set on restyle if our background colour has no alpha,
+	 * so that we hide whatever is drawn underneath us. occluded is set by
+	 * our surface's occlusion pass if something opaque in front of us
+	 * covers our whole clip rect, and means our subtree isn't drawn. */
+	int opaque;
+	int occluded;
+
+	TAILQ_ENTRY(rtb_element) child;
+	TAILQ_ENTRY(rtb_element) render_entry;
+
+	struct rtb_stylequad stylequad;
 
+	/* public *********************************/
 	struct rtb_style *style;
 
 	/* XXX: should this stuff be in rtb_style_t? */
 	rtb_alignment_t align;
 	struct rtb_padding outer_pad;
 	struct rtb_padding inner_pad;
-
-	TAILQ_HEAD(children, rtb_element) children;
+	struct rtb_layout_params layout;
 
 	/* private ********************************/
-	rtb_elem_state_t state;
-	rtb_visibility_t visibility;
 	struct rtb_rect inner_rect;
-	struct rtb_stylequad stylequad;
+
+	/* the element's resolved style for its current state, indexed by
+	 * built-in property id. inherited properties the element's own style
+	 * doesn't set carry the parent's value. restyle diffs against this. */
+	const struct rtb_style_property_definition
+		*computed_style[RTB_PROP_BUILTIN_COUNT];
+	int style_stale;
+	unsigned int style_pass;
+
+	/* selector matching. the class and id vectors are only allocated
+	 * once something is put in them. matched_rules is sorted by
+	 * descending specificity, and style_filter covers this element and
+	 * all of its ancestors. */
+	struct rtb_style_name style_id;
+	VECTOR(style_classes, struct rtb_style_name) classes;
+	VECTOR(matched_rules, struct rtb_style *) matched_rules;
+	struct rtb_style_filter style_filter;
+
+	/* reflows are queued on the window and run in one batch before the
+	 * next frame is drawn. reflow_instigator is NULL if more than one
+	 * child asked for the rootward reflow. */
+	unsigned int reflow_pending;
+	struct rtb_element *reflow_instigator;
+
+	/* inside rtb_elem_begin_mutation(), adding and removing children
+	 * only records here what the outermost commit has to restyle and
+	 * reflow. */
+	struct {
+		unsigned int depth;
+		unsigned int pending;
+	} mutation;
+
+	/* the element's geometry as of its last reflow. a rootward reflow
+	 * only reflows the children whose layout has moved on from this. */
+	struct rtb_rect reflowed_rect;
+
+	/* rtb_elem_request_size()'s last answer. only valid while generation
+	 * matches the window's measure_generation, and zeroed whenever a
+	 * reflow is triggered on the element or anything leafward of it. */
+	struct rtb_measure_cache {
+		rtb_elem_cb_size_t size_cb;
+		struct rtb_size avail;
+		struct rtb_size want;
+		unsigned int generation;
+	} measure_cache;
 
 	/* assign these via the stylesheet */
 	struct rtb_size min_size;
@@ -240,13 +364,34 @@ struct rtb_element {
 
 	int mouse_in;
 
-	struct rtb_element *parent;
-	struct rtb_window  *window;
-	struct rtb_surface *surface;
-
-	VECTOR(handlers, struct rtb_event_handler) handlers;
-	TAILQ_ENTRY(rtb_element) child;
-	TAILQ_ENTRY(rtb_element) render_entry;
+	/* the first few handlers are stored inline, so most elements never
+	 * allocate for them. overflow goes in `spilled`. see event.c.
+	 *
+	 * bit n of sys_mask is set if there's a handler for built-in event
+	 * type n, and sys_first holds one more than the index of the first
+	 * of them (or 0 if it's too far along to fit). other event types set
+	 * bit (type % 32) of user_mask. an event whose bit isn't set can be
+	 * turned away without looking at the handlers at all.
+	 *
+	 * while rtb_handle() is running (dispatching > 0), handlers that are
+	 * unregistered only have their callback cleared, and are taken out
+	 * once the outermost dispatch is done. */
+	struct rtb_handler_list {
+		struct rtb_event_handler *spilled;
+		unsigned int size;
+		unsigned int capacity;
+		unsigned int dispatching;
+
+		uint32_t sys_mask;
+		uint32_t user_mask;
+		unsigned char sys_first[RTB_EVENT_SYS_COUNT];
+
+		struct rtb_event_handler inline_storage[RTB_INLINE_HANDLERS];
+	} handlers;
+
+	/* set by the rtb_*_new() constructors, for rtb_elem_free_subtree().
+	 * NULL for elements that are embedded in something else. */
+	rtb_elem_cb_t release;
 };
 
 int rtb_elem_deliver_event(struct rtb_element *, const struct rtb_event *e);
@@ -277,6 +422,24 @@ int rtb_elem_is_clearable(struct rtb_element *);
 struct rtb_element *rtb_elem_nearest_clearable(struct rtb_element *);
 
 void rtb_elem_mark_dirty(struct rtb_element *);
+
+/**
+ * sets the element's visibility and updates the cached visibility of
+ * everything under it.
+ */
+void rtb_elem_set_visibility(struct rtb_element *, rtb_visibility_t);
+
+/**
+ * returns the more obscured of the element's own visibility and the one
+ * its clipping gives it.
+ */
+rtb_visibility_t rtb_elem_visibility(const struct rtb_element *);
+
+/**
+ * queues a reflow of the element. nothing is laid out until the window
+ * next draws (or rtb_window_flush_reflow() is called), so any number of
+ * changes to a subtree between frames cost one layout pass.
+ */
 void rtb_elem_trigger_reflow(struct rtb_element *,
 		struct rtb_element *instigator, rtb_ev_direction_t direction);
 void rtb_elem_reflow_leafward(struct rtb_element *);
@@ -290,10 +453,51 @@ void rtb_elem_set_position_from_point(struct rtb_element *, struct rtb_point *);
 void rtb_elem_set_position(struct rtb_element *, float x, float y);
 void rtb_elem_set_size(struct rtb_element *, struct rtb_size *);
 
+/**
+ * classes and ids, for the stylesheet's selectors to match against.
+ * changing them restyles only what the stylesheet's rules can reach.
+ */
+int rtb_elem_add_class(struct rtb_element *, const char *class_name);
+int rtb_elem_remove_class(struct rtb_element *, const char *class_name);
+int rtb_elem_has_class(struct rtb_element *, const char *class_name);
+int rtb_elem_set_id(struct rtb_element *, const char *id);
+
 int rtb_elem_is_in_tree(struct rtb_element *root, struct rtb_element *leaf);
 void rtb_elem_add_child(struct rtb_element *parent, struct rtb_element *child,
 		rtb_child_add_loc_t where);
 void rtb_elem_remove_child(struct rtb_element *, struct rtb_element *child);
 
+/**
+ * batches changes to an element's children. between begin and the
+ * matching commit, rtb_elem_add_child() and rtb_elem_remove_child() on
+ * the element attach and detach as usual, but the restyle and reflow they
+ * would each trigger are held back and done once, at commit.
+ *
+ * transactions nest, and only the outermost commit does any work.
+ */
+void rtb_elem_begin_mutation(struct rtb_element *);
+void rtb_elem_commit_mutation(struct rtb_element *);
+
+/**
+ * add or remove `count` children in one transaction. rtb_elem_add_children()
+ * keeps the children in array order at either end of the list.
+ */
+void rtb_elem_add_children(struct rtb_element *parent,
+		struct rtb_element **children, size_t count,
+		rtb_child_add_loc_t where);
+void rtb_elem_remove_children(struct rtb_element *parent,
+		struct rtb_element **children, size_t count);
+
+/**
+ * finalises and frees a detached element along with everything under it
+ * that came from one of the rtb_*_new() constructors, without detaching
+ * or restyling anything along the way. children embedded in an element
+ * are finalised by that element as usual.
+ *
+ * elements that weren't created with a constructor are left alone, but
+ * their constructed children are still freed.
+ */
+void rtb_elem_free_subtree(struct rtb_element *);
+
 int rtb_elem_init(struct rtb_element *);
 void rtb_elem_fini(struct rtb_element *);
@@ -88,6 +88,11 @@ enum {
 };
 #undef SYS
 
+/* how many of the built-in types there are above, and where one of them
+ * falls among them. */
+#define RTB_EVENT_SYS_COUNT 20
+#define RTB_EVENT_SYS_INDEX(x) ((x) & ~RTB_EVENT_SYS_MASK)
+
 typedef enum {
 	RTB_DIRECTION_LEAFWARD,
 	RTB_DIRECTION_ROOTWARD
@@ -131,8 +136,9 @@ struct rtb_event_handler {
  * public API
  */
 
-// returns -1 if no handler for this event. otherwise, returns the return value
-// of the handler.
+// returns -1 if no handler for this event. otherwise, calls the handlers for
+// the event's type in the order they were registered until one of them
+// returns nonzero, and returns what the last one called returned.
 int rtb_handle(struct rtb_element *target, const struct rtb_event *event);
 
 struct rtb_element *rtb_dispatch_raw(struct rtb_element *target,
@@ -140,11 +146,18 @@ struct rtb_element *rtb_dispatch_raw(struct rtb_element *target,
 struct rtb_element *rtb_dispatch_simple(struct rtb_element *target,
 		rtb_ev_type_t type);
 
+// adds a handler after any others already registered for the type.
 int rtb_register_handler(struct rtb_element *on_elem,
 		rtb_ev_type_t for_type, rtb_event_cb_t handler, void *context);
+
+// removes every handler registered for the type.
 void rtb_unregister_handler(struct rtb_element *on_elem,
 		rtb_ev_type_t for_type);
 
+// removes just the handler registered with this callback and context.
+void rtb_unregister_handler_cb(struct rtb_element *on_elem,
+		rtb_ev_type_t for_type, rtb_event_cb_t handler, void *context);
+
 void rtb_event_loop_init(struct rutabaga *);
 void rtb_event_loop_run(struct rutabaga *);
 void rtb_event_loop_fini(struct rutabaga *);
@@ -36,6 +36,27 @@
 #define RTB_FONT(x) RTB_UPCAST(x, rtb_font)
 #define RTB_FONT_AS(x, type) RTB_DOWNCAST(x, type, rtb_font)
 
+/* number of glyph sets (one per dpi) the font manager keeps resident at
+ * once. moving a window back and forth between two monitors with
+ * different scaling only rasterizes glyphs the first time. */
+#define RTB_FONT_MANAGER_GLYPH_SETS 3
+
+struct rtb_text_object;
+
+/**
+ * a glyph set is an atlas rasterized at one particular dpi. every managed
+ * font has one texture_font_t per glyph set, and `rtb_font.txfont` always
+ * points at the one belonging to the font manager's current set.
+ */
+
+struct rtb_glyph_set {
+	int dpi_x;
+	int dpi_y;
+
+	texture_atlas_t *atlas;
+	unsigned last_used;
+};
+
 struct rtb_font {
 	int size;
 	float lcd_gamma;
@@ -43,6 +64,17 @@ struct rtb_font {
 	texture_font_t *txfont;
 	struct rtb_font_manager *fm;
 
+	/* private ********************************/
+	texture_font_t *set_txfonts[RTB_FONT_MANAGER_GLYPH_SETS];
+
+	/* where glyph sets get rasterized from: either the font file at
+	 * `path`, or `size` bytes at `base`. */
+	struct {
+		const char *path;
+		const void *base;
+		size_t size;
+	} source;
+
 	TAILQ_ENTRY(rtb_font) manager_entry;
 };
 
@@ -63,7 +95,13 @@ struct rtb_font_manager {
 
 	const rtb_utf32_t *cache_glyphs;
 
+	/* private ********************************/
+	struct rtb_glyph_set sets[RTB_FONT_MANAGER_GLYPH_SETS];
+	int current_set;
+	unsigned set_clock;
+
 	TAILQ_HEAD(managed_fonts, rtb_font) managed_fonts;
+	TAILQ_HEAD(managed_text_objects, rtb_text_object) text_objects;
 };
 
 int rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
@@ -74,5 +112,14 @@ int rtb_font_manager_load_external_font(struct rtb_font_manager *fm,
 		struct rtb_external_font *font, int pt_size, const char *path);
 void rtb_font_manager_free_external_font(struct rtb_external_font *font);
 
+/**
+ * switches every managed font over to glyphs rasterized at the given dpi.
+ * if a glyph set for this dpi is already resident, this is just a pointer
+ * swap. on failure, the previous glyph set stays current.
+ *
+ * text objects are not touched -- see rtb_text_object_reproject().
+ */
+int rtb_font_manager_set_dpi(struct rtb_font_manager *, int dpi_x, int dpi_y);
+
 int rtb_font_manager_init(struct rtb_font_manager *, int dpi_x, int dpi_y);
 void rtb_font_manager_fini(struct rtb_font_manager *);
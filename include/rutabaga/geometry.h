@@ -108,6 +108,33 @@ rtb_rect_update_points_from_size(struct rtb_rect *rect)
 	rect->y2 = rect->y + rect->h;
 }
 
+/**
+ * stores the overlap of `a` and `b` in `dst`, which may be either of
+ * them. if they don't overlap, `dst` ends up with zero size and 0 is
+ * returned.
+ */
+static inline int
+rtb_rect_intersect(struct rtb_rect *dst,
+		const struct rtb_rect *a, const struct rtb_rect *b)
+{
+	struct rtb_rect r;
+
+	r.x  = (a->x  > b->x)  ? a->x  : b->x;
+	r.y  = (a->y  > b->y)  ? a->y  : b->y;
+	r.x2 = (a->x2 < b->x2) ? a->x2 : b->x2;
+	r.y2 = (a->y2 < b->y2) ? a->y2 : b->y2;
+
+	if (r.x2 < r.x)
+		r.x2 = r.x;
+	if (r.y2 < r.y)
+		r.y2 = r.y;
+
+	rtb_rect_update_size_from_points(&r);
+	*dst = r;
+
+	return r.w > 0.f && r.h > 0.f;
+}
+
 struct rtb_window;
 
 struct rtb_phy_size rtb_size_to_phy(struct rtb_window *,
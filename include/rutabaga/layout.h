@@ -48,6 +48,15 @@ void rtb_size_vfill(struct rtb_element *,
 void rtb_size_fill(struct rtb_element *,
 		const struct rtb_size *avail, struct rtb_size *want);
 
+void rtb_size_hflex(struct rtb_element *,
+		const struct rtb_size *avail, struct rtb_size *want);
+
+void rtb_size_vflex(struct rtb_element *,
+		const struct rtb_size *avail, struct rtb_size *want);
+
+void rtb_size_grid(struct rtb_element *,
+		const struct rtb_size *avail, struct rtb_size *want);
+
 void rtb_layout_unmanaged(struct rtb_element *);
 
 void rtb_layout_vpack_top(struct rtb_element *);
@@ -59,3 +68,25 @@ void rtb_layout_hpack_center(struct rtb_element *);
 void rtb_layout_hpack_right(struct rtb_element *);
 
 void rtb_layout_hdistribute(struct rtb_element *);
+
+/**
+ * flex layouts lay children out along one axis. each child starts at its
+ * layout.basis (or its measured size), and then whatever space is left
+ * over is shared out by layout.grow, or taken back by layout.shrink
+ * (weighted by basis). with layout.wrap set on the container, children
+ * that don't fit go on a new line.
+ */
+void rtb_layout_hflex(struct rtb_element *);
+void rtb_layout_vflex(struct rtb_element *);
+
+/**
+ * the grid layout puts children in row-major order into layout.columns
+ * columns. each column is as wide as its widest child and each row as
+ * tall as its tallest, with any leftover width shared between the
+ * columns. children are aligned within their cells by their align, or
+ * stretched to fill them if their layout.grow is set. layout.columns is
+ * clamped to RTB_LAYOUT_GRID_MAX_COLUMNS.
+ */
+#define RTB_LAYOUT_GRID_MAX_COLUMNS 64
+
+void rtb_layout_grid(struct rtb_element *);
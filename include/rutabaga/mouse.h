@@ -33,6 +33,8 @@
 #define RTB_EVENT_MOUSE(x) RTB_UPCAST(x, rtb_event_mouse)
 #define RTB_EVENT_DRAG(x) RTB_UPCAST(x, rtb_event_drag)
 
+#define RTB_MOUSE_MOTION_HISTORY 64
+
 /**
  * types
  */
@@ -132,6 +134,13 @@ struct rtb_mouse {
 
 	rtb_mouse_button_mask_t buttons_down;
 	rtb_mouse_cursor_t current_cursor;
+
+	/* the raw positions that went into the motion being dispatched,
+	 * oldest first. see rtb_mouse_motion_history(). */
+	struct {
+		struct rtb_point points[RTB_MOUSE_MOTION_HISTORY];
+		unsigned int count;
+	} history;
 };
 
 /**
@@ -144,3 +153,14 @@ rtb_mouse_set_cursor(struct rtb_window *, struct rtb_mouse *,
 
 void
 rtb_mouse_unset_cursor(struct rtb_window *, struct rtb_mouse *);
+
+/**
+ * platforms coalesce runs of pointer motion into a single motion (and
+ * drag) event, whose position and delta are those of the whole run.
+ * from inside a handler for that event, this gives the positions the
+ * run was made up of, oldest first, with the event's own cursor last.
+ * only the most recent RTB_MOUSE_MOTION_HISTORY are kept.
+ */
+unsigned int
+rtb_mouse_motion_history(struct rtb_window *,
+		const struct rtb_point **points);
@@ -45,6 +45,11 @@ void rtb__platform_mouse_release(struct rtb_window *,
 		int buttons, struct rtb_point);
 void rtb__platform_mouse_motion(struct rtb_window *, struct rtb_point);
 
+/* records a position that will be coalesced into the next call to
+ * rtb__platform_mouse_motion(). platforms which don't coalesce motion
+ * needn't call this. */
+void rtb__platform_mouse_motion_sample(struct rtb_window *, struct rtb_point);
+
 void rtb__platform_mouse_wheel(struct rtb_window *, struct rtb_point,
 		float delta);
 
@@ -32,7 +32,6 @@
 #include <rutabaga/defaults.h>
 #include <rutabaga/types.h>
 #include <rutabaga/atom.h>
-#include <rutabaga/dict.h>
 
 #include "wwrl/allocator.h"
 
@@ -46,10 +45,6 @@ struct rutabaga {
 	int owns_application_event_loop;
 
 	/* private ********************************/
-	struct {
-		RTB_DICT(rtb_atom_dict, rtb_atom_descriptor) type;
-	} atoms;
-
 	/* XXX: need to be able to handle several of these */
 	struct rtb_window *win;
 
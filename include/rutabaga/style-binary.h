@@ -0,0 +1,160 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <rutabaga/types.h>
+#include <rutabaga/style.h>
+
+/**
+ * binary stylesheets, as written by the stylesheet compiler's
+ * rtb_style_binary() build rule (waftools/rutabaga_css/binary.py).
+ *
+ * everything is little-endian and 4-byte aligned. every reference is an
+ * offset from the start of the file, 0 meaning "none". strings and asset
+ * data are used in place, so loading one only allocates and fills in the
+ * small rtb_style structures that point into it.
+ */
+
+#define RTB_STYLE_BINARY_MAGIC   "RTBS"
+#define RTB_STYLE_BINARY_VERSION 1
+
+struct rtb_style_binary_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t size;
+
+	uint32_t nstyles;
+	uint32_t styles;     /* -> rtb_style_binary_style[nstyles] */
+
+	uint32_t nprops;
+	uint32_t prop_names; /* -> uint32_t[nprops], string offsets */
+
+	uint32_t nfonts;
+};
+
+struct rtb_style_binary_name {
+	uint32_t name;
+	uint32_t hash;
+};
+
+struct rtb_style_binary_compound {
+	struct rtb_style_binary_name type;
+	struct rtb_style_binary_name id;
+
+	uint32_t nclasses;
+	uint32_t classes;    /* -> rtb_style_binary_name[nclasses] */
+};
+
+struct rtb_style_binary_selector {
+	uint32_t specificity;
+	uint32_t ncompounds;
+	struct rtb_style_binary_compound compounds[];
+};
+
+struct rtb_style_binary_style {
+	uint32_t for_type;
+	uint32_t selector;   /* -> rtb_style_binary_selector */
+
+	/* -> rtb_style_binary_property[nproperties[state]] */
+	uint32_t properties[RTB_DRAW_STATE_COUNT];
+	uint32_t nproperties[RTB_DRAW_STATE_COUNT];
+};
+
+struct rtb_style_binary_asset {
+	uint32_t location;   /* rtb_asset_location_t */
+
+	/* embedded: the asset data. external: its path. */
+	uint32_t data;
+	uint32_t size;
+};
+
+struct rtb_style_binary_font_face {
+	uint32_t family;
+	uint32_t weight;
+	struct rtb_style_binary_asset asset;
+};
+
+struct rtb_style_binary_property {
+	uint32_t name;
+	uint32_t id;         /* interned, see rtb_style_prop_id_t */
+	uint32_t type;       /* rtb_style_prop_type_t */
+
+	union {
+		float color[4];
+		float flt;
+		int32_t i;
+
+		struct {
+			uint32_t asset; /* -> rtb_style_binary_asset */
+			uint32_t w, h;
+			uint32_t flags;
+			uint32_t border[4]; /* top, right, bottom, left */
+		} texture;
+
+		struct {
+			uint32_t face;  /* -> rtb_style_binary_font_face */
+			int32_t size;
+			float lcd_gamma;
+			uint32_t slot;
+		} font;
+
+		uint8_t payload[32];
+	};
+};
+
+/**
+ * a loaded binary stylesheet
+ */
+
+struct rtb_style_binary {
+	/* public *********************************/
+
+	/* ready to hand to rtb_style_add_theme(). valid until the
+	 * stylesheet is unloaded. */
+	struct rtb_style_data data;
+
+	/* private ********************************/
+	const uint8_t *base;
+	size_t size;
+
+	/* length of the mapping (or of the buffer we read the file into),
+	 * or 0 if the caller owns the memory. */
+	size_t mapped;
+
+	void *block;
+};
+
+/**
+ * public API
+ */
+
+int rtb_style_binary_load(struct rtb_style_binary *, const char *path);
+int rtb_style_binary_load_buffer(struct rtb_style_binary *,
+		const void *buffer, size_t size);
+void rtb_style_binary_unload(struct rtb_style_binary *);
@@ -43,6 +43,17 @@ typedef enum {
 	RTB_STYLE_PROP_TYPE_COUNT
 } rtb_style_prop_type_t;
 
+#define RTB_PROP_BIT(id) (1u << (id))
+
+/* built-in properties that an element picks up from its ancestors when
+ * its own style doesn't set them. */
+#define RTB_STYLE_INHERITED_PROPS \
+	(RTB_PROP_BIT(RTB_PROP_COLOR) | RTB_PROP_BIT(RTB_PROP_FONT))
+
+/* one flattened lookup table per element state (not per draw state),
+ * since the state fallbacks differ between e.g. HOVER and FOCUS_HOVER. */
+#define RTB_STYLE_STATE_COUNT (RTB_STATE_FOCUS_ACTIVE + 1)
+
 typedef enum {
 	RTB_TEXTURE_VERTICAL_STRETCH   = 0x0,
 	RTB_TEXTURE_HORIZONTAL_STRETCH = 0x0,
@@ -88,6 +99,38 @@ struct rtb_rgb_color {
 	GLfloat r, g, b, a;
 };
 
+/**
+ * selectors
+ */
+
+/* the specificity a plain type selector has. rules more specific than
+ * this win over the element's type style, rules less specific (`*`)
+ * lose to it. */
+#define RTB_STYLE_TYPE_SPECIFICITY 0x000001
+
+typedef enum {
+	RTB_STYLE_SELECTOR_CLASS,
+	RTB_STYLE_SELECTOR_ID
+} rtb_style_selector_kind_t;
+
+/* one compound selector, e.g. `button.primary` or `#master`. */
+struct rtb_style_compound {
+	struct rtb_style_name type; /* NULL name matches any type */
+	struct rtb_style_name id;   /* NULL name if there's no id */
+
+	/* terminated by a NULL name. may itself be NULL. */
+	const struct rtb_style_name *classes;
+};
+
+/* compounds[0] is the subject. the rest are ancestors it has to be a
+ * descendant of, going rootward. specificity is packed as 0xIICCTT
+ * (ids, classes, types). */
+struct rtb_style_selector {
+	const struct rtb_style_compound *compounds;
+	int ncompounds;
+	unsigned int specificity;
+};
+
 /**
  * the meat and potatoes
  */
@@ -95,6 +138,7 @@ struct rtb_rgb_color {
 struct rtb_style_property_definition {
 	/* public *********************************/
 	const char *property_name;
+	rtb_style_prop_id_t id;
 	rtb_style_prop_type_t type;
 
 	union {
@@ -111,14 +155,37 @@ struct rtb_style {
 	const char *for_type;
 	const struct rtb_style_property_definition *properties[RTB_DRAW_STATE_COUNT];
 
+	/* NULL for plain type styles. otherwise this is a rule that applies
+	 * on top of the type style of whichever elements it matches, and
+	 * for_type is its subject's type (or the base element type). */
+	const struct rtb_style_selector *selector;
+
 	/* private ********************************/
 	struct rtb_style *inherit_from;
 	struct rtb_type_atom_descriptor *resolved_type;
+
+	/* built by rtb_style_resolve_list(). indexed by property id, with
+	 * inheritance and state fallbacks already applied. these point into
+	 * theme_lookup[] for whichever theme is active. */
+	const struct rtb_style_property_definition **lookup[RTB_STYLE_STATE_COUNT];
+
+	/* one set of tables per theme, built the first time the style is
+	 * needed under that theme. index 0 is the window's own stylesheet. */
+	const struct rtb_style_property_definition
+		**(*theme_lookup)[RTB_STYLE_STATE_COUNT];
+	int ntheme_lookups;
+
+	/* set by rtb_style_set_theme() if the switch changed any of this
+	 * style's tables. */
+	int theme_changed;
 };
 
 struct rtb_style_data {
 	struct rtb_style *style;
 	size_t nfonts;
+
+	const char *const *prop_names;
+	size_t nprops;
 };
 
 /**
@@ -126,11 +193,57 @@ struct rtb_style_data {
  */
 
 const struct rtb_style_property_definition *rtb_style_query_prop(
-		struct rtb_element *elem, const char *property_name,
+		struct rtb_element *elem, rtb_style_prop_id_t prop_id,
 		rtb_style_prop_type_t type, int should_return_fallback);
+/**
+ * like rtb_style_query_prop(), but if `leaf` doesn't set the property,
+ * its nearest ancestor that does wins. for inherited properties (see
+ * RTB_STYLE_INHERITED_PROPS) this is a read of the computed style that
+ * restyle propagated down the tree; anything else walks rootward.
+ */
 const struct rtb_style_property_definition *rtb_style_query_prop_in_tree(
-		struct rtb_element *leaf, const char *property_name,
+		struct rtb_element *leaf, rtb_style_prop_id_t prop_id,
 		rtb_style_prop_type_t type, int should_return_fallback);
+
+/**
+ * returns the interned id of a property, or -1 if the window's stylesheet
+ * doesn't mention it. only needed for properties that aren't built in, and
+ * the result should be cached.
+ */
+int rtb_style_prop_id(struct rtb_window *, const char *property_name);
+
+/**
+ * the property that applies to `elem` in its current state, out of its
+ * matched rules and its type style. no inheritance, no type check.
+ */
+const struct rtb_style_property_definition *rtb_style_elem_lookup(
+		struct rtb_element *elem, rtb_style_prop_id_t prop_id);
+
+/**
+ * selector matching. rtb_style_match_rules() recomputes which rules apply
+ * to `elem` and its ancestor filter; restyle calls it for stale elements.
+ * rtb_style_invalidate() restyles whatever adding or removing a class or
+ * id on `elem` can affect, which is nothing at all if no rule uses it.
+ */
+uint32_t rtb_style_hash(const char *name);
+void rtb_style_match_rules(struct rtb_element *elem);
+void rtb_style_invalidate(struct rtb_element *elem,
+		rtb_style_selector_kind_t kind, const char *name);
+
+/**
+ * the flattened lookup table for a style in a given element state, or NULL
+ * if `style` is NULL or hasn't been resolved.
+ */
+/**
+ * whether two property definitions would style an element the same way.
+ * definitions from different stylesheets (e.g. a theme and the window's
+ * own) are never the same object, so they have to be compared like this.
+ */
+int rtb_style_props_equal(const struct rtb_style_property_definition *,
+		const struct rtb_style_property_definition *);
+
+const struct rtb_style_property_definition *const *rtb_style_snapshot(
+		struct rtb_style *style, rtb_elem_state_t state);
 int rtb_style_elem_has_properties_for_state(struct rtb_element *elem,
 		rtb_elem_state_t state);
 
@@ -142,6 +255,22 @@ struct rtb_style *rtb_style_for_element(struct rtb_element *elem,
 int rtb_style_resolve_list(struct rtb_window *,
 		struct rtb_style *style_list);
 
+/**
+ * themes are alternate stylesheets layered over the window's own. a
+ * theme's styles are matched up with the window's by type and selector,
+ * and only have to set the properties they change. the theme's style list
+ * is only ever read from, and has to outlive the window.
+ *
+ * rtb_style_add_theme() returns the new theme's id, or -1 on error.
+ * theme 0 is the window's own stylesheet. switching swaps each style's
+ * prebuilt tables and restyles only the elements whose tables changed.
+ */
+int rtb_style_add_theme(struct rtb_window *, struct rtb_style_data theme);
+int rtb_style_set_theme(struct rtb_window *, int theme);
+void rtb_style_free_themes(struct rtb_window *);
+void rtb_style_free_type_cache(struct rtb_window *);
+void rtb_style_free_list(struct rtb_style *style_list);
+
 struct rtb_font *rtb_style_get_font_for_def(struct rtb_window *,
 		const struct rtb_style_font_definition *);
 
@@ -48,24 +48,31 @@ typedef enum {
 struct rtb_stylequad {
 	struct rtb_point offset;
 
+	/* the vertex buffer is only created, and the geometry only uploaded,
+	 * once the stylequad actually draws something. */
 	GLuint vertices;
+	struct rtb_size size;
+	int geometry_stale;
 
 	struct {
 		const struct rtb_rgb_color *bg_color;
 		const struct rtb_rgb_color *border_color;
 	} properties;
 
-	struct rtb_stylequad_texture {
-		const struct rtb_style_texture_definition *definition;
-		GLuint gl_handle;
-		GLuint coords;
-	} border_image, background_image;
+	/* NULL until an image is set. */
+	struct rtb_stylequad_textures {
+		struct rtb_stylequad_texture {
+			const struct rtb_style_texture_definition *definition;
+			GLuint gl_handle;
+			GLuint coords;
+		} border_image, background_image;
+	} *textures;
 };
 
-void rtb_stylequad_draw(const struct rtb_stylequad *,
+void rtb_stylequad_draw(struct rtb_stylequad *,
 		struct rtb_render_context *, const struct rtb_point *center,
 		rtb_stylequad_draw_mode_t);
-void rtb_stylequad_draw_solid(const struct rtb_stylequad *self,
+void rtb_stylequad_draw_solid(struct rtb_stylequad *self,
 		struct rtb_render_context *ctx, const struct rtb_point *center);
 void rtb_stylequad_draw_on_element(struct rtb_stylequad *,
 		struct rtb_element *, rtb_stylequad_draw_mode_t);
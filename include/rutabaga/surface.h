@@ -56,6 +56,23 @@ struct rtb_surface {
 
 	struct rtb_phy_size phy_size;
 	mat4 phy_projection;
+
+	/* opaque rects in front of whatever the occlusion pass is looking
+	 * at. only kept around so we don't reallocate every redraw.
+	 * the pass itself only runs when occlusion_stale is set, which is
+	 * whenever something under us changes its clip, opacity or place
+	 * in the tree. */
+	VECTOR(occluders, struct rtb_rect) occluders;
+	int occlusion_stale;
+
+	/* public *********************************/
+
+	/* what the last redraw of this surface drew, and what it skipped
+	 * because it was hidden behind something opaque. */
+	struct {
+		unsigned int drawn;
+		unsigned int occluded;
+	} draw_stats;
 };
 
 int rtb_surface_is_dirty(struct rtb_surface *);
@@ -41,6 +41,17 @@ struct rtb_text_object {
 	vertex_buffer_t *vertices;
 	struct rtb_font_manager *fm;
 	const struct rtb_font *font;
+
+	/* private ********************************/
+	struct {
+		rtb_utf32_t *codepoints;
+		size_t length;
+		size_t capacity;
+
+		float line_height_multiplier;
+	} layout;
+
+	TAILQ_ENTRY(rtb_text_object) manager_entry;
 };
 
 int rtb_text_object_get_glyph_rect(struct rtb_text_object *, int idx,
@@ -50,6 +61,15 @@ int rtb_text_object_count_glyphs(struct rtb_text_object *);
 int rtb_text_object_update(struct rtb_text_object *,
 		struct rtb_font *rfont, struct rtb_window *,
 		const rtb_utf8_t *text, float line_height_multiplier);
+
+/**
+ * rebuilds the vertices from the already-decoded text after a scale or
+ * glyph set change. cheaper than rtb_text_object_update() and doesn't
+ * need the original string.
+ */
+int rtb_text_object_reproject(struct rtb_text_object *,
+		struct rtb_window *);
+
 void rtb_text_object_render(struct rtb_text_object *,
 		struct rtb_render_context *ctx, float x, float y,
 		const struct rtb_rgb_color *color);
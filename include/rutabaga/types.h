@@ -74,6 +74,45 @@ typedef enum {
 	RTB_DRAW_STATE_COUNT
 } rtb_draw_state_t;
 
+/**
+ * interned property ids. the stylesheet compiler assigns these, and the
+ * order of the built-in ones has to match `builtin_props` in
+ * waftools/rutabaga_css/style.py. properties that aren't built in get ids
+ * starting at RTB_PROP_BUILTIN_COUNT -- use rtb_style_prop_id() in
+ * style.h to look them up by name.
+ */
+
+typedef enum {
+	RTB_PROP_COLOR = 0,
+	RTB_PROP_BACKGROUND_COLOR,
+	RTB_PROP_BACKGROUND_IMAGE,
+	RTB_PROP_BORDER_IMAGE,
+	RTB_PROP_BORDER_COLOR,
+	RTB_PROP_MIN_WIDTH,
+	RTB_PROP_MIN_HEIGHT,
+	RTB_PROP_FONT,
+	RTB_PROP_KNOB_ROTOR,
+
+	RTB_PROP_BUILTIN_COUNT
+} rtb_style_prop_id_t;
+
+/**
+ * a bloom filter over the hashed type, class, and id names of an element
+ * and all of its ancestors. lets style.c reject descendant selectors
+ * without walking rootward.
+ */
+
+#define RTB_STYLE_FILTER_BITS 256
+
+struct rtb_style_filter {
+	uint32_t bits[RTB_STYLE_FILTER_BITS / 32];
+};
+
+struct rtb_style_name {
+	const char *name;
+	uint32_t hash;
+};
+
 typedef enum {
 	RTB_FULLY_OBSCURED     = 0x0,
 	RTB_PARTIALLY_OBSCURED = 0x1,
@@ -67,6 +67,13 @@ struct rtb_window_local_storage {
 	} ibo;
 };
 
+struct rtb_reflow_request {
+	struct rtb_element *elem;
+
+	/* filled in by rtb_window_flush_reflow() */
+	unsigned int depth;
+};
+
 struct rtb_window {
 	RTB_INHERIT(rtb_surface);
 	struct rtb_font_manager font_manager;
@@ -77,6 +84,30 @@ struct rtb_window {
 	struct rtb_style *style_list;
 	struct rtb_font *style_fonts;
 
+	const char *const *style_prop_names;
+	size_t style_nprops;
+
+	/* the per-type style cache is only valid for entries tagged with
+	 * style_generation. it's bumped when the theme changes, and when
+	 * style.c notices that style_list isn't the list the cache was built
+	 * from (style_cache_list). changing the list in place isn't noticed,
+	 * so bump the generation yourself if you do that. */
+	unsigned int style_generation;
+	struct rtb_style *style_cache_list;
+
+	/* bumped on each theme change. elements record the pass they were
+	 * last restyled in (rtb_element.style_pass) so that a theme change
+	 * restyles each of them at most once. */
+	unsigned int theme_pass;
+	struct rtb_style_type_cache *style_type_cache;
+	unsigned int style_type_cache_size;
+
+	/* see rtb_style_add_theme(). style_theme is the active one, and 0
+	 * means the window's own stylesheet. */
+	struct rtb_style_theme *style_themes;
+	int style_nthemes;
+	int style_theme;
+
 	/* private ********************************/
 	int finished_initialising;
 
@@ -96,6 +127,19 @@ struct rtb_window {
 	int dirty;
 	uv_mutex_t lock;
 
+	VECTOR(reflow_queue, struct rtb_reflow_request) reflow_queue;
+	int flushing_reflow;
+
+	/* bumped when every element's cached measurement goes stale at once,
+	 * e.g. when the window's scale changes. never 0. */
+	unsigned int measure_generation;
+
+	struct rtb_layout_pool *layout_pool;
+
+	/* packed copies of every attached element's geometry. see
+	 * rtb_private/geometry-store.h */
+	struct rtb_geometry_store *geometry;
+
 	struct rtb_mouse mouse;
 	struct rtb_element *focus;
 };
@@ -117,6 +161,23 @@ void rtb_window_unlock(struct rtb_window *);
 
 void rtb_window_reinit(struct rtb_window *);
 
+/**
+ * runs every queued reflow now rather than before the next frame. only
+ * needed by code that reads back geometry straight after changing the
+ * tree.
+ */
+void rtb_window_flush_reflow(struct rtb_window *);
+
+/**
+ * for the platform layer to call when the window ends up on a display with
+ * a different scale factor. phy_size should already be up to date.
+ *
+ * switches the font manager over to a glyph set for the new dpi (reusing
+ * one if the window has been at this scale before), re-projects all text
+ * objects and reflows the window.
+ */
+int rtb_window_set_scale(struct rtb_window *, struct rtb_point scale);
+
 /**
  * opening/closing
  */
@@ -24,212 +24,82 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
+#include <assert.h>
 
 #include <rutabaga/rutabaga.h>
-#include <rutabaga/window.h>
-#include <rutabaga/dict.h>
 #include <rutabaga/atom.h>
 
-typedef unsigned int uint_t;
+/* every registered type, indexed by id. slot 0 is unused so that an id
+ * of 0 means "not registered yet". */
+static struct rtb_type_atom_descriptor **registry;
+static unsigned int registry_size;
 
 /**
- * meiyan hash from http://www.sanmayce.com/Fastest_Hash/
- */
-
-#ifndef _rotl
-# define _rotl(x, n) (((x) << (n)) | ((x) >> (32-(n))))
-# define _rotr(x, n) (((x) << (n)) | ((x) >> (32-(n))))
-#endif
-
-#ifndef __forceinline
-# define __forceinline inline
-#endif
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-align"
-static unsigned int
-hash_meiyan(const char *str, size_t wrdlen)
-{
-	const unsigned int PRIME = 709607;
-	unsigned int hash32 = 2166136261;
-	const char *p = str;
-
-	for(; wrdlen >= 2 * sizeof(uint32_t);
-			wrdlen -= 2 * sizeof(uint32_t),
-			p      += 2 * sizeof(uint32_t)) {
-		hash32 = (hash32 ^ (_rotl(*(uint32_t *)p,5) ^ *(uint32_t *)(p+4))) * PRIME;
-	}
-
-	// Cases: 0,1,2,3,4,5,6,7
-	if (wrdlen & sizeof(uint32_t)) {
-		hash32 = (hash32 ^ *(uint16_t*)p) * PRIME;
-		p += sizeof(uint16_t);
-		hash32 = (hash32 ^ *(uint16_t*)p) * PRIME;
-		p += sizeof(uint16_t);
-	}
-
-	if (wrdlen & sizeof(uint16_t)) {
-		hash32 = (hash32 ^ *(uint16_t*)p) * PRIME;
-		p += sizeof(uint16_t);
-	}
-
-	if (wrdlen & 1)
-		hash32 = (hash32 ^ *p) * PRIME;
-
-	return hash32 ^ (hash32 >> 16);
-}
-#pragma GCC diagnostic pop
-
-#define HASH(str, len) hash_meiyan(str, len)
-
-/**
- * nedtries stuff
+ * RTB_ATOM_TYPE public API
  */
 
-static size_t
-dict_key_func(const struct rtb_atom_descriptor *node)
-{
-	return node->dict_entry.hash;
-}
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-function"
-NEDTRIE_GENERATE(static, rtb_atom_dict, rtb_atom_descriptor,
-		dict_entry.trie_entry, dict_key_func,
-		NEDTRIE_NOBBLEZEROS(rtb_atom_dict));
-#pragma GCC diagnostic pop
-
-static struct rtb_type_atom_descriptor *
-find_type_descriptor(struct rtb_atom_dict *dict,
-		uint_t hash, const char *type_name, size_t len)
-{
-	struct rtb_atom_descriptor needle = {.dict_entry.hash = hash}, *ret;
-
-	ret = NEDTRIE_FIND(rtb_atom_dict, dict, &needle);
-
-	while (ret && strcmp(type_name, ret->name))
-		ret = NEDTRIE_NEXTLEAF(rtb_atom_dict, ret);
-
-	return (struct rtb_type_atom_descriptor *) ret;
-}
-
-static struct rtb_type_atom_descriptor *
-alloc_type_descriptor(uint_t hash, const char *type_name, size_t len,
-		struct rtb_type_atom_descriptor *supertype)
+struct rtb_type_atom_descriptor *
+rtb_type_lookup(const char *type_name)
 {
-	struct rtb_type_atom_descriptor *ret, **cursor;
-	size_t need = sizeof(*ret), name_start;
-	int supertypes = 0;
-	char *name;
-
-	if (supertype)
-		for (cursor = supertype->super, supertypes = 1;
-				*cursor; cursor++, supertypes++);
-
-	need += (supertypes + 1) * sizeof(struct rtb_atom_descriptor *);
-
-	name_start = need;
-	need += len + 1;
-	ret = calloc(1, need);
-
-	ret->dict_entry.hash = hash;
-	ret->ref_count = 0;
-	ret->name = name = ((char *) ret) + name_start;
-
-	strncpy(name, type_name, len);
-	name[len] = '\0';
-
-	if (supertype) {
-		ret->super[0] = supertype;
+	unsigned int i;
 
-		/* copy parent's supertype array into ours */
-		memcpy(&ret->super[1], supertype->super,
-				(supertypes - 1) * sizeof(*ret->super));
-	}
-
-	ret->super[supertypes] = NULL;
+	for (i = 1; i < registry_size; i++)
+		if (!strcmp(registry[i]->name, type_name))
+			return registry[i];
 
-	return ret;
+	return NULL;
 }
 
-
-/**
- * RTB_ATOM_TYPE public API
- */
-
 struct rtb_type_atom_descriptor *
-rtb_type_lookup(struct rtb_window *win, const char *type_name)
+rtb_type_by_id(unsigned int id)
 {
-	uint_t hash;
-	int len;
+	if (!id || id >= registry_size)
+		return NULL;
 
-	len = strlen(type_name);
-	hash = HASH(type_name, len);
-
-	return find_type_descriptor(&win->rtb->atoms.type, hash, type_name, len);
+	return registry[id];
 }
 
-int
-rtb_is_type(struct rtb_type_atom_descriptor *desc,
-		struct rtb_type_atom *atom)
+unsigned int
+rtb_type_count(void)
 {
-	struct rtb_type_atom_descriptor *type_a, *type_b;
-
-	type_a = desc;
-	type_b = atom->type;
-
-	do {
-		if (type_a == type_b)
-			return 1;
-	} while ((type_b = type_b->super[0]));
-
-	return 0;
+	return registry_size;
 }
 
 struct rtb_type_atom_descriptor *
-rtb_type_ref(struct rtb_window *win, struct rtb_type_atom_descriptor *super,
-		const char *type_name)
+rtb_type_register(struct rtb_type_atom_descriptor *type,
+		struct rtb_type_atom_descriptor *super)
 {
-	struct rtb_atom_dict *dict = &win->rtb->atoms.type;
-	struct rtb_type_atom_descriptor *type, *supertype;
-	uint_t hash;
-	int len;
+	struct rtb_type_atom_descriptor **grown;
+	unsigned int size;
 
-	supertype = (struct rtb_type_atom_descriptor *) super;
+	if (type->id) {
+		assert(RTB_TYPE_SUPER(type) == super);
+		return type;
+	}
 
-	len = strlen(type_name);
-	hash = HASH(type_name, len);
+	size = registry_size ? registry_size + 1 : 2;
+	if (!(grown = realloc(registry, size * sizeof(*registry))))
+		return NULL;
 
-	type = find_type_descriptor(dict, hash, type_name, len);
+	registry = grown;
+	registry[0] = NULL;
 
-	if (!type) {
-		if (!(type = alloc_type_descriptor(hash, type_name, len, supertype)))
-			return NULL;
+	if (super) {
+		assert(super->id && super->depth + 1 < RTB_TYPE_MAX_DEPTH);
 
-		type->dict = dict;
-		NEDTRIE_INSERT(rtb_atom_dict, dict, RTB_ATOM_DESCRIPTOR(type));
-	}
+		type->depth = super->depth + 1;
+		memcpy(type->ancestors, super->ancestors,
+				type->depth * sizeof(*type->ancestors));
+	} else
+		type->depth = 0;
 
-	type->ref_count++;
-	return type;
-}
-
-int
-rtb_type_unref(struct rtb_type_atom_descriptor *type)
-{
-	if (!type)
-		return -1;
+	type->ancestors[type->depth] = type;
+	type->id = size - 1;
 
-	rtb_type_unref(type->super[0]);
+	registry[type->id] = type;
+	registry_size = size;
 
-	if (!--type->ref_count) {
-		NEDTRIE_REMOVE(rtb_atom_dict, type->dict, RTB_ATOM_DESCRIPTOR(type));
-		free(type);
-		return 0;
-	}
-
-	return type->ref_count;
+	return type;
 }
@@ -31,7 +31,12 @@
 #include <rutabaga/element.h>
 #include <rutabaga/window.h>
 
+#include "rtb_private/slab.h"
+
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation container_impl;
+static struct rtb_type_atom_descriptor container_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.container");
 
 /**
  * element implementation
@@ -42,8 +47,14 @@ attached(struct rtb_element *self,
 		struct rtb_element *parent, struct rtb_window *window)
 {
 	super.attached(self, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.container");
+	self->type = rtb_type_register(&container_type, self->type);
+}
+
+static void
+release(struct rtb_element *self)
+{
+	rtb_elem_fini(self);
+	slab_allocator.free(self);
 }
 
 /**
@@ -53,17 +64,20 @@ attached(struct rtb_element *self,
 rtb_container_t *
 rtb_container_new()
 {
-	rtb_container_t *self = calloc(1, sizeof(*self));
+	rtb_container_t *self = slab_allocator.calloc(1, sizeof(*self));
 
 	if (!self)
 		return NULL;
 
 	if (RTB_SUBCLASS(self, rtb_elem_init, &super)) {
-		free(self);
+		slab_allocator.free(self);
 		return NULL;
 	}
 
-	self->attached = attached;
+	container_impl = super;
+	container_impl.attached = attached;
+	self->impl    = &container_impl;
+	self->release = release;
 
 	return self;
 }
@@ -45,10 +45,16 @@
 #include <rutabaga/mouse.h>
 
 #include "rtb_private/stdlib-allocator.h"
+#include "rtb_private/slab.h"
 #include "rtb_private/layout-debug.h"
+#include "rtb_private/layout-pool.h"
+#include "rtb_private/geometry-store.h"
 
 #include "wwrl/vector.h"
 
+static struct rtb_type_atom_descriptor element_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.element");
+
 /**
  * state machine
  */
@@ -67,7 +73,7 @@ change_state(struct rtb_element *self, rtb_elem_state_t state)
 		return 0;
 
 	self->state = state;
-	self->restyle(self);
+	self->impl->restyle(self);
 
 	return 0;
 }
@@ -160,36 +166,229 @@ transition_unfocus(struct rtb_element *self)
 	}
 }
 
+/**
+ * occlusion
+ */
+
+/* the surface works out what's hidden behind what lazily, so it only
+ * needs telling when something that goes into that changes. */
+static void
+occlusion_changed(struct rtb_element *self)
+{
+	if (self->surface)
+		self->surface->occlusion_stale = 1;
+}
+
+/**
+ * cached visibility
+ */
+
+/* recomputes the element's opaque_ancestor and effectively_visible from
+ * its parent's, and carries on down the tree wherever they changed. */
+static void
+update_cached_visibility(struct rtb_element *self, int force)
+{
+	struct rtb_element *iter, *parent = self->parent, *opaque = NULL;
+	int visible = (rtb_elem_visibility(self) != RTB_FULLY_OBSCURED);
+
+	if (!parent || parent == self)
+		goto out;
+
+	/* the surface is as far up as either of these go */
+	if (parent == RTB_ELEMENT(self->surface)) {
+		visible = visible
+			&& rtb_elem_visibility(parent) != RTB_FULLY_OBSCURED;
+		goto out;
+	}
+
+	visible = visible && parent->effectively_visible;
+
+	if (parent->opaque_ancestor)
+		opaque = parent->opaque_ancestor;
+	else if (parent->stylequad.properties.bg_color)
+		opaque = parent;
+
+out:
+
+	if (!force && self->opaque_ancestor == opaque
+			&& self->effectively_visible == visible)
+		return;
+
+	self->opaque_ancestor = opaque;
+	self->effectively_visible = visible;
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		update_cached_visibility(iter, 0);
+}
+
+/**
+ * clipping
+ */
+
+static int
+rect_moved(const struct rtb_rect *a, const struct rtb_rect *b)
+{
+	return a->x != b->x || a->y != b->y || a->x2 != b->x2 || a->y2 != b->y2;
+}
+
+/* clips the element against its parent, sets its clip_visibility to
+ * match and syncs it to the geometry store, then carries on down the
+ * tree wherever the clip changed. */
+static void
+update_clip(struct rtb_element *self)
+{
+	struct rtb_element *iter, *parent = self->parent;
+	rtb_visibility_t visibility = self->clip_visibility;
+	const struct rtb_rect *bounds;
+	struct rtb_rect clip = self->rect;
+	int changed;
+
+	if (parent && parent != self) {
+		/* a surface draws its children into its own framebuffer, so
+		 * they're only clipped to its bounds. */
+		if (parent == RTB_ELEMENT(self->surface))
+			bounds = &parent->rect;
+		else
+			bounds = &parent->clip_rect;
+
+		if (!rtb_rect_intersect(&clip, &self->rect, bounds))
+			visibility = RTB_FULLY_OBSCURED;
+		else if (clip.w < self->w || clip.h < self->h)
+			visibility = RTB_PARTIALLY_OBSCURED;
+		else
+			visibility = RTB_UNOBSCURED;
+	}
+
+	changed = rect_moved(&clip, &self->clip_rect)
+		|| visibility != self->clip_visibility;
+
+	if (changed) {
+		self->clip_rect = clip;
+		occlusion_changed(self);
+
+		if (visibility != self->clip_visibility) {
+			self->clip_visibility = visibility;
+			update_cached_visibility(self, 1);
+		}
+	}
+
+	/* our rect can move without the clip changing (if we're clipped
+	 * away entirely), so this happens either way. it's cheap if nothing
+	 * moved. */
+	rtb_geometry_store_sync(self->window->geometry, self);
+
+	if (!changed)
+		return;
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		update_clip(iter);
+}
+
 /**
  * reflow
  */
 
+static void
+dequeue_reflow(struct rtb_element *self, struct rtb_window *window)
+{
+	size_t i;
+
+	/* rtb_window_flush_reflow() skips the empty slot */
+	for (i = 0; i < window->reflow_queue.size; i++)
+		if (window->reflow_queue.data[i].elem == self)
+			window->reflow_queue.data[i].elem = NULL;
+
+	self->reflow_pending = 0;
+	self->reflow_instigator = NULL;
+}
+
+static void
+update_rects(struct rtb_element *self)
+{
+	rtb_rect_update_points_from_size(&self->rect);
+
+	self->inner_rect.x  = self->x  + self->outer_pad.x;
+	self->inner_rect.y  = self->y  + self->outer_pad.y;
+	self->inner_rect.x2 = self->x2 - self->outer_pad.x;
+	self->inner_rect.y2 = self->y2 - self->outer_pad.y;
+	rtb_rect_update_size_from_points(&self->inner_rect);
+}
+
+/* the part of a leafward reflow that only touches the element and its
+ * children's geometry, which is safe to run off the main thread. see
+ * rtb_layout_pool_lay_out(). */
+void
+rtb_elem_layout_geometry(struct rtb_element *self)
+{
+	update_rects(self);
+	self->layout_cb(self);
+	self->reflow_pending |= RTB_REFLOW_LAID_OUT;
+}
+
+static int
+geometry_changed(struct rtb_element *self)
+{
+	return self->x != self->reflowed_rect.x
+		|| self->y != self->reflowed_rect.y
+		|| self->w != self->reflowed_rect.w
+		|| self->h != self->reflowed_rect.h;
+}
+
+/* whether the element now wants a different size from its parent than
+ * it did when it was last measured. */
+static int
+measurement_changed(struct rtb_element *self)
+{
+	struct rtb_measure_cache *cache = &self->measure_cache;
+	struct rtb_size avail, want, old_want;
+
+	if (self->size_cb == rtb_size_self)
+		return 0;
+
+	if (!cache->size_cb)
+		return 1;
+
+	avail = cache->avail;
+	old_want = cache->want;
+
+	rtb_elem_request_size(self, &avail, &want);
+	return want.w != old_want.w || want.h != old_want.h;
+}
+
 static int
 reflow_rootward(struct rtb_element *self,
 		struct rtb_element *instigator, rtb_ev_direction_t direction)
 {
 	struct rtb_element *iter;
-	struct rtb_size inst_old_size = {
-		instigator->w,
-		instigator->h
-	};
+	int relaid = 0;
+
+	/* a queued rootward reflow of this element gets folded into this
+	 * one. */
+	self->reflow_pending &= ~(RTB_REFLOW_ROOTWARD | RTB_REFLOW_LAID_OUT);
 
 	self->layout_cb(self);
 
-	/* don't pass the reflow any further rootward if the element's
-	 * size hasn't changed as a result of it. */
-	if ((instigator->w == inst_old_size.w &&
-	     instigator->h == inst_old_size.h))
-		return 0;
+	TAILQ_FOREACH(iter, &self->children, child) {
+		if (!geometry_changed(iter))
+			continue;
 
-	TAILQ_FOREACH(iter, &self->children, child)
-		iter->reflow(iter, self, RTB_DIRECTION_LEAFWARD);
+		iter->impl->reflow(iter, self, RTB_DIRECTION_LEAFWARD);
+		relaid = 1;
+	}
 
-	if (self->parent)
-		self->parent->reflow(self->parent, self, direction);
+	/* only pass the reflow further rootward if our parent would now lay
+	 * us out differently. */
+	if (self->parent && self->parent != self
+			&& !(self->flags & RTB_ELEM_LAYOUT_ROOT)
+			&& measurement_changed(self)) {
+		self->parent->impl->reflow(self->parent, self, direction);
+		relaid = 1;
+	}
 
-	rtb_elem_mark_dirty(self);
-	return 1;
+	if (relaid)
+		rtb_elem_mark_dirty(self);
+
+	return relaid;
 }
 
 static void
@@ -198,10 +397,14 @@ reflow_leafward(struct rtb_element *self,
 {
 	struct rtb_element *iter;
 
-	self->layout_cb(self);
+	/* rtb_layout_pool_lay_out() may have beaten us to it */
+	if (self->reflow_pending & RTB_REFLOW_LAID_OUT)
+		self->reflow_pending &= ~RTB_REFLOW_LAID_OUT;
+	else
+		self->layout_cb(self);
 
 	TAILQ_FOREACH(iter, &self->children, child)
-		iter->reflow(iter, self, direction);
+		iter->impl->reflow(iter, self, direction);
 }
 
 static int
@@ -211,13 +414,20 @@ reflow(struct rtb_element *self,
 	if (!self->window->finished_initialising)
 		return 0;
 
-	rtb_rect_update_points_from_size(&self->rect);
+	/* a leafward pass redoes this element's layout, so a queued leafward
+	 * reflow of it is redundant. a queued rootward one still has to run,
+	 * but its instigator will already have been resized by then. */
+	if (direction == RTB_DIRECTION_LEAFWARD) {
+		self->reflow_pending &= ~RTB_REFLOW_LEAFWARD;
 
-	self->inner_rect.x  = self->x  + self->outer_pad.x;
-	self->inner_rect.y  = self->y  + self->outer_pad.y;
-	self->inner_rect.x2 = self->x2 - self->outer_pad.x;
-	self->inner_rect.y2 = self->y2 - self->outer_pad.y;
-	rtb_rect_update_size_from_points(&self->inner_rect);
+		if (self->reflow_pending & RTB_REFLOW_ROOTWARD)
+			self->reflow_instigator = NULL;
+	}
+
+	update_rects(self);
+	self->reflowed_rect = self->rect;
+
+	update_clip(self);
 
 	rtb_stylequad_update_geometry(&self->stylequad, &self->rect);
 
@@ -239,18 +449,68 @@ reflow(struct rtb_element *self,
  * styling
  */
 
+/* rebuilds computed_style for the element's current state and returns a
+ * mask of the built-in properties whose value changed. */
+static unsigned int
+compute_style(struct rtb_element *self)
+{
+	const struct rtb_style_property_definition *const *inherited, *prop;
+	unsigned int changed;
+	int id;
+
+	if (self->parent && self->parent != self)
+		inherited = self->parent->computed_style;
+	else
+		inherited = NULL;
+
+	changed = 0;
+
+	for (id = 0; id < RTB_PROP_BUILTIN_COUNT; id++) {
+		prop = rtb_style_elem_lookup(self, id);
+
+		if (!prop && inherited
+				&& (RTB_STYLE_INHERITED_PROPS & RTB_PROP_BIT(id)))
+			prop = inherited[id];
+
+		if (prop == self->computed_style[id])
+			continue;
+
+		/* themes have their own definitions even for values they
+		 * don't change, so only count it if the value is different. */
+		if (!rtb_style_props_equal(prop, self->computed_style[id]))
+			changed |= RTB_PROP_BIT(id);
+
+		self->computed_style[id] = prop;
+	}
+
+	return changed;
+}
+
+static const struct rtb_style_property_definition *
+computed_prop(struct rtb_element *self, rtb_style_prop_id_t id,
+		rtb_style_prop_type_t type)
+{
+	const struct rtb_style_property_definition *prop;
+
+	prop = self->computed_style[id];
+	return (prop && prop->type == type) ? prop : NULL;
+}
+
 static void
-reload_style(struct rtb_element *self)
+reload_style(struct rtb_element *self, unsigned int changed)
 {
 	const struct rtb_style_property_definition *prop;
-	int need_reflow = 0;
+	const struct rtb_rgb_color *had_bg = self->stylequad.properties.bg_color;
+	struct rtb_element *iter;
+	int need_reflow = 0, was_opaque = self->opaque;
 
 	/* layout-related properties trigger a reflow if they change, so
 	 * we'll handle them first. */
 
-#define ASSIGN_LAYOUT_FLOAT(pname, dest) do {                         \
-	prop = rtb_style_query_prop(self,                                 \
-			pname, RTB_STYLE_PROP_FLOAT, 0);                          \
+#define ASSIGN_LAYOUT_FLOAT(prop_id, dest) do {                       \
+	if (!(changed & RTB_PROP_BIT(prop_id)))                           \
+		break;                                                        \
+	prop = computed_prop(self, prop_id, RTB_STYLE_PROP_FLOAT);        \
 	if (!prop)                                                        \
 		break;                                                        \
 	if (self->dest != prop->flt                                       \
@@ -261,35 +521,53 @@ reload_style(struct rtb_element *self)
 		self->dest = prop->flt;                                       \
 } while (0)
 
-	ASSIGN_LAYOUT_FLOAT("min-width", min_size.w);
-	ASSIGN_LAYOUT_FLOAT("min-height", min_size.h);
+	ASSIGN_LAYOUT_FLOAT(RTB_PROP_MIN_WIDTH, min_size.w);
+	ASSIGN_LAYOUT_FLOAT(RTB_PROP_MIN_HEIGHT, min_size.h);
 
 #undef ASSIGN_LAYOUT_FLOAT
 
-#define LOAD_PROP(name, type, member, load_func)                      \
-	if ((prop = rtb_style_query_prop(self, name, type, 0))            \
+#define LOAD_PROP(id, type, member, load_func)                        \
+	if ((changed & RTB_PROP_BIT(id))                                  \
+			&& (prop = computed_prop(self, id, type))                 \
 			&& !load_func(&self->stylequad, &prop->member))           \
 
-#define LOAD_COLOR(name, load_func)                                   \
-		LOAD_PROP(name, RTB_STYLE_PROP_COLOR, color, load_func) {     \
+#define LOAD_COLOR(id, load_func)                                     \
+		LOAD_PROP(id, RTB_STYLE_PROP_COLOR, color, load_func) {       \
 			rtb_elem_mark_dirty(self);                                \
 		}
 
-#define LOAD_TEXTURE(name, load_func)                                 \
-		LOAD_PROP(name, RTB_STYLE_PROP_TEXTURE, texture, load_func) { \
+#define LOAD_TEXTURE(id, load_func)                                   \
+		LOAD_PROP(id, RTB_STYLE_PROP_TEXTURE, texture, load_func) {   \
 			rtb_elem_mark_dirty(self);                                \
 		}
 
-	LOAD_COLOR("background-color", rtb_stylequad_set_background_color);
-	LOAD_COLOR("border-color", rtb_stylequad_set_border_color);
+	LOAD_COLOR(RTB_PROP_BACKGROUND_COLOR, rtb_stylequad_set_background_color);
+	LOAD_COLOR(RTB_PROP_BORDER_COLOR, rtb_stylequad_set_border_color);
 
-	LOAD_TEXTURE("border-image", rtb_stylequad_set_border_image);
-	LOAD_TEXTURE("background-image", rtb_stylequad_set_background_image);
+	LOAD_TEXTURE(RTB_PROP_BORDER_IMAGE, rtb_stylequad_set_border_image);
+	LOAD_TEXTURE(RTB_PROP_BACKGROUND_IMAGE, rtb_stylequad_set_background_image);
 
 #undef LOAD_TEXTURE
 #undef LOAD_COLOR
 #undef LOAD_PROP
 
+	self->opaque = self->stylequad.properties.bg_color
+		&& self->stylequad.properties.bg_color->a >= 1.f;
+
+	if (self->opaque != was_opaque)
+		occlusion_changed(self);
+
+	/* whether we have a background decides where our descendants
+	 * clear from */
+	if (!had_bg != !self->stylequad.properties.bg_color)
+		TAILQ_FOREACH(iter, &self->children, child)
+			update_cached_visibility(iter, 0);
+
+	/* the inherited properties don't go through the stylequad, but
+	 * subclasses draw with them. */
+	if (changed & RTB_STYLE_INHERITED_PROPS)
+		rtb_elem_mark_dirty(self);
+
 	if (need_reflow)
 		rtb_elem_reflow_rootward(self);
 }
@@ -298,16 +576,30 @@ static void
 restyle(struct rtb_element *self)
 {
 	struct rtb_element *iter;
+	unsigned int changed;
 
 	assert(self->window->state != RTB_STATE_UNATTACHED);
 
 	if (!self->style)
 		self->style = rtb_style_for_element(self, self->window->style_list);
 
-	reload_style(self);
+	/* only stale elements get their selectors rematched. state changes
+	 * don't affect which rules match, just which of their tables apply. */
+	if (self->style_stale)
+		rtb_style_match_rules(self);
+
+	self->style_stale = 0;
+	self->style_pass = self->window->theme_pass;
+	changed = compute_style(self);
 
+	if (changed)
+		reload_style(self, changed);
+
+	/* children only need to hear about it if something they inherit from
+	 * us changed, or if they haven't been styled since being attached. */
 	TAILQ_FOREACH(iter, &self->children, child)
-		iter->restyle(iter);
+		if (iter->style_stale || (changed & RTB_STYLE_INHERITED_PROPS))
+			iter->impl->restyle(iter);
 }
 
 /**
@@ -346,31 +638,59 @@ attached(struct rtb_element *self,
 
 	self->parent = parent;
 	self->window = window;
+	self->measure_cache.generation = 0;
+
+	/* make sure the first layout after attaching reaches us */
+	self->reflowed_rect.w = -1.f;
 
-	self->type = rtb_type_ref(window, NULL, "net.illest.rutabaga.element");
+	self->type = rtb_type_register(&element_type, NULL);
+	rtb_geometry_store_attach(window->geometry, self);
+	update_cached_visibility(self, 1);
+	occlusion_changed(self);
 
 	self->layout_cb(self);
+	self->style_stale = 1;
 
 	TAILQ_FOREACH(iter, &self->children, child)
-		self->child_attached(self, iter);
+		self->impl->child_attached(self, iter);
 
 	change_state(self, RTB_STATE_NORMAL);
 }
 
+/* a queued element that's been detached can't be drawn, and its surface
+ * can't place it in the tree any more. */
+static void
+dequeue_render(struct rtb_element *self)
+{
+	if (!RTB_ELEMENT_IS_MARKED_DIRTY(self))
+		return;
+
+	TAILQ_REMOVE(&self->surface->render_queue, self, render_entry);
+
+	self->render_entry.tqe_next = NULL;
+	self->render_entry.tqe_prev = NULL;
+}
+
 static void
 detached(struct rtb_element *self,
 		struct rtb_element *parent, struct rtb_window *window)
 {
 	struct rtb_element *iter;
 
+	if (self->reflow_pending & RTB_REFLOW_QUEUED)
+		dequeue_reflow(self, self->window);
+
+	dequeue_render(self);
+	occlusion_changed(self);
+
+	rtb_geometry_store_detach(self->window->geometry, self);
+
 	self->parent = NULL;
 	self->window = NULL;
-
-	rtb_type_unref(self->type);
 	self->type = NULL;
 
 	TAILQ_FOREACH(iter, &self->children, child)
-		self->child_detached(self, iter);
+		self->impl->child_detached(self, iter);
 
 	change_state(self, RTB_STATE_UNATTACHED);
 }
@@ -379,13 +699,13 @@ static void
 child_attached(struct rtb_element *self, struct rtb_element *child)
 {
 	child->surface = self->surface;
-	child->attached(child, self, self->window);
+	child->impl->attached(child, self, self->window);
 }
 
 static void
 child_detached(struct rtb_element *self, struct rtb_element *child)
 {
-	child->detached(child, self, self->window);
+	child->impl->detached(child, self, self->window);
 }
 
 static void
@@ -393,17 +713,13 @@ mark_dirty(struct rtb_element *self)
 {
 	struct rtb_surface *surface = self->surface;
 
-	for (; self != RTB_ELEMENT(surface); self = self->parent) {
-		if (self->visibility == RTB_FULLY_OBSCURED)
-			return;
+	if (!surface || surface->surface_state == RTB_SURFACE_INVALID
+			|| !self->effectively_visible)
+		return;
 
-		if (rtb_elem_is_clearable(self))
-			break;
-	}
+	self = rtb_elem_nearest_clearable(self);
 
-	if (!surface || surface->surface_state == RTB_SURFACE_INVALID
-			|| !rtb_elem_is_visible(self)
-			|| self->render_entry.tqe_next || self->render_entry.tqe_prev)
+	if (self->render_entry.tqe_next || self->render_entry.tqe_prev)
 		return;
 
 	TAILQ_INSERT_TAIL(&surface->render_queue, self, render_entry);
@@ -424,7 +740,7 @@ rtb_elem_deliver_event(struct rtb_element *self, const struct rtb_event *e)
 	if (self->state == RTB_STATE_UNATTACHED)
 		return 0;
 
-	ret = self->on_event(self, e);
+	ret = self->impl->on_event(self, e);
 	ret = (rtb_handle(self, e) != -1) || ret;
 
 	switch (e->type) {
@@ -469,14 +785,21 @@ rtb_elem_draw_children(struct rtb_element *self)
 void
 rtb_elem_draw(struct rtb_element *self, int clear_first)
 {
-	if (self->visibility == RTB_FULLY_OBSCURED)
+	if (rtb_elem_visibility(self) == RTB_FULLY_OBSCURED)
 		return;
 
+	if (self->occluded) {
+		self->surface->draw_stats.occluded++;
+		return;
+	}
+
+	self->surface->draw_stats.drawn++;
+
 	rtb_render_push(self);
 	if (clear_first)
 		rtb_render_clear(self);
 
-	self->draw(self);
+	self->impl->draw(self);
 	LAYOUT_DEBUG_DRAW_BOX(self);
 
 	rtb_render_pop(self);
@@ -485,47 +808,58 @@ rtb_elem_draw(struct rtb_element *self, int clear_first)
 int
 rtb_elem_is_visible(struct rtb_element *self)
 {
-	struct rtb_surface *surface = self->surface;
-
-	for (; self != RTB_ELEMENT(surface); self = self->parent)
-		if (self->visibility == RTB_FULLY_OBSCURED)
-			return 0;
-
-	return (surface->visibility != RTB_FULLY_OBSCURED);
+	return self->effectively_visible;
 }
 
 int
 rtb_elem_is_clearable(struct rtb_element *self)
 {
-	struct rtb_surface *surface = self->surface;
-
-	/* XXX: shouldn't depend on stylequad like this */
-
-	for (self = self->parent;
-			self != RTB_ELEMENT(surface); self = self->parent)
-		if (self->stylequad.properties.bg_color)
-			return 0;
-
-	return 1;
+	return !self->opaque_ancestor;
 }
 
 struct rtb_element *
 rtb_elem_nearest_clearable(struct rtb_element *self)
 {
-	struct rtb_surface *surface = self->surface;
-
-	for (; self != RTB_ELEMENT(surface); self = self->parent)
-		if (rtb_elem_is_clearable(self))
-			return self;
+	return self->opaque_ancestor ? self->opaque_ancestor : self;
+}
 
-	return RTB_ELEMENT(surface);
+/* anything that can change an element's measurement comes through
+ * rtb_elem_trigger_reflow(), which drops the cached measurements of the
+ * element and everything rootward of it. */
+static void
+invalidate_measure(struct rtb_element *self)
+{
+	for (; self; self = (self->parent != self) ? self->parent : NULL)
+		self->measure_cache.generation = 0;
 }
 
 void
 rtb_elem_trigger_reflow(struct rtb_element *self, struct rtb_element *instigator,
 		rtb_ev_direction_t direction)
 {
-	self->reflow(self, instigator, direction);
+	struct rtb_reflow_request req = {self, 0};
+
+	if (!self->window)
+		return;
+
+	if (instigator)
+		instigator->measure_cache.generation = 0;
+
+	invalidate_measure(self);
+
+	if (direction == RTB_DIRECTION_LEAFWARD)
+		self->reflow_pending |= RTB_REFLOW_LEAFWARD;
+	else if (!(self->reflow_pending & RTB_REFLOW_ROOTWARD)) {
+		self->reflow_pending |= RTB_REFLOW_ROOTWARD;
+		self->reflow_instigator = instigator;
+	} else if (self->reflow_instigator != instigator)
+		self->reflow_instigator = NULL;
+
+	if (self->reflow_pending & RTB_REFLOW_QUEUED)
+		return;
+
+	self->reflow_pending |= RTB_REFLOW_QUEUED;
+	VECTOR_PUSH_BACK(&self->window->reflow_queue, &req);
 }
 
 void
@@ -543,7 +877,30 @@ rtb_elem_reflow_rootward(struct rtb_element *self)
 void
 rtb_elem_mark_dirty(struct rtb_element *self)
 {
-	self->mark_dirty(self);
+	self->impl->mark_dirty(self);
+}
+
+void
+rtb_elem_set_visibility(struct rtb_element *self, rtb_visibility_t visibility)
+{
+	if (self->visibility == visibility)
+		return;
+
+	self->visibility = visibility;
+
+	if (self->window) {
+		update_cached_visibility(self, 1);
+		occlusion_changed(self);
+		rtb_geometry_store_sync(self->window->geometry, self);
+	}
+}
+
+rtb_visibility_t
+rtb_elem_visibility(const struct rtb_element *self)
+{
+	/* RTB_FULLY_OBSCURED is the lowest, RTB_UNOBSCURED the highest */
+	return (self->visibility < self->clip_visibility)
+		? self->visibility : self->clip_visibility;
 }
 
 void
@@ -573,20 +930,138 @@ rtb_elem_set_position(struct rtb_element *self, float x, float y)
 	rtb_elem_set_position_from_point(self, &positition);
 }
 
+/* the fit-children measurements only look at the element's children, so
+ * one answer does for any available size. */
+static int
+measure_ignores_avail(rtb_elem_cb_size_t size_cb)
+{
+	return size_cb == rtb_size_hfit_children
+		|| size_cb == rtb_size_vfit_children;
+}
+
 void
 rtb_elem_request_size(struct rtb_element *self,
 		const struct rtb_size *avail, struct rtb_size *want)
 {
+	struct rtb_measure_cache *cache = &self->measure_cache;
+
+	/* rtb_size_self is cheaper than looking in the cache */
+	if (!self->window || self->size_cb == rtb_size_self) {
+		self->size_cb(self, avail, want);
+		return;
+	}
+
+	if (cache->generation == self->window->measure_generation
+			&& cache->size_cb == self->size_cb
+			&& (measure_ignores_avail(self->size_cb)
+				|| (cache->avail.w == avail->w
+					&& cache->avail.h == avail->h))) {
+		*want = cache->want;
+		return;
+	}
+
 	self->size_cb(self, avail, want);
+
+	cache->size_cb = self->size_cb;
+	cache->avail = *avail;
+	cache->want = *want;
+	cache->generation = self->window->measure_generation;
 }
 
 void
 rtb_elem_set_size(struct rtb_element *self, struct rtb_size *sz)
 {
+	if (self->w != sz->w || self->h != sz->h)
+		self->measure_cache.generation = 0;
+
 	self->w = sz->w;
 	self->h = sz->h;
 }
 
+static int
+find_class(struct rtb_element *self, const char *class_name)
+{
+	size_t i;
+
+	for (i = 0; i < self->classes.size; i++)
+		if (!strcmp(self->classes.data[i].name, class_name))
+			return i;
+
+	return -1;
+}
+
+int
+rtb_elem_has_class(struct rtb_element *self, const char *class_name)
+{
+	return find_class(self, class_name) >= 0;
+}
+
+int
+rtb_elem_add_class(struct rtb_element *self, const char *class_name)
+{
+	struct rtb_style_name class;
+
+	if (find_class(self, class_name) >= 0)
+		return 0;
+
+	if (!(class.name = strdup(class_name)))
+		return -1;
+
+	class.hash = rtb_style_hash(class_name);
+
+	if (!self->classes.data)
+		VECTOR_INIT(&self->classes, &stdlib_allocator, 2);
+
+	VECTOR_PUSH_BACK(&self->classes, &class);
+	rtb_style_invalidate(self, RTB_STYLE_SELECTOR_CLASS, class_name);
+
+	return 0;
+}
+
+int
+rtb_elem_remove_class(struct rtb_element *self, const char *class_name)
+{
+	char *name;
+	int idx;
+
+	if ((idx = find_class(self, class_name)) < 0)
+		return -1;
+
+	name = (char *) self->classes.data[idx].name;
+	VECTOR_ERASE(&self->classes, idx);
+
+	rtb_style_invalidate(self, RTB_STYLE_SELECTOR_CLASS, name);
+	free(name);
+
+	return 0;
+}
+
+int
+rtb_elem_set_id(struct rtb_element *self, const char *id)
+{
+	char *old_id, *new_id;
+
+	if (self->style_id.name && id && !strcmp(self->style_id.name, id))
+		return 0;
+
+	new_id = NULL;
+	if (id && !(new_id = strdup(id)))
+		return -1;
+
+	old_id = (char *) self->style_id.name;
+
+	self->style_id.name = new_id;
+	self->style_id.hash = id ? rtb_style_hash(id) : 0;
+
+	if (old_id)
+		rtb_style_invalidate(self, RTB_STYLE_SELECTOR_ID, old_id);
+	if (new_id)
+		rtb_style_invalidate(self, RTB_STYLE_SELECTOR_ID, new_id);
+
+	free(old_id);
+	return 0;
+}
+
 int
 rtb_elem_is_in_tree(struct rtb_element *root, struct rtb_element *leaf)
 {
@@ -601,31 +1076,37 @@ void
 rtb_elem_add_child(struct rtb_element *self, struct rtb_element *child,
 		rtb_child_add_loc_t where)
 {
-	assert(child->draw);
-	assert(child->on_event);
+	assert(child->impl->draw);
+	assert(child->impl->on_event);
 	assert(child->layout_cb);
 	assert(child->size_cb);
-	assert(child->attached);
-	assert(child->detached);
-	assert(child->child_attached);
-	assert(child->child_detached);
-	assert(child->reflow);
-	assert(child->restyle);
-	assert(child->mark_dirty);
+	assert(child->impl->attached);
+	assert(child->impl->detached);
+	assert(child->impl->child_attached);
+	assert(child->impl->child_detached);
+	assert(child->impl->reflow);
+	assert(child->impl->restyle);
+	assert(child->impl->mark_dirty);
 
 	if (where == RTB_ADD_HEAD)
 		TAILQ_INSERT_HEAD(&self->children, child, child);
 	else
 		TAILQ_INSERT_TAIL(&self->children, child, child);
 
-	if (self->state != RTB_STATE_UNATTACHED) {
-		self->child_attached(self, child);
+	if (self->state == RTB_STATE_UNATTACHED)
+		return;
 
-		if (self->window->state != RTB_STATE_UNATTACHED)
-			self->restyle(self);
+	self->impl->child_attached(self, child);
 
-		self->reflow(self, child, RTB_DIRECTION_ROOTWARD);
+	if (self->mutation.depth) {
+		self->mutation.pending |= RTB_MUTATION_ATTACHED;
+		return;
 	}
+
+	if (self->window->state != RTB_STATE_UNATTACHED)
+		self->impl->restyle(self);
+
+	rtb_elem_trigger_reflow(self, child, RTB_DIRECTION_ROOTWARD);
 }
 
 void
@@ -636,9 +1117,6 @@ rtb_elem_remove_child(struct rtb_element *self, struct rtb_element *child)
 	if (self->state == RTB_STATE_UNATTACHED)
 		return;
 
-	if (self->render_entry.tqe_next && self->render_entry.tqe_prev)
-		TAILQ_REMOVE(&self->surface->render_queue, self, render_entry);
-
 	if (child->mouse_in) {
 		if (self->window->mouse.buttons_down) {
 			struct rtb_mouse_button *b;
@@ -654,22 +1132,127 @@ rtb_elem_remove_child(struct rtb_element *self, struct rtb_element *child)
 		self->window->mouse.element_underneath = self;
 	}
 
-	self->child_detached(self, child);
+	self->impl->child_detached(self, child);
 
 	child->parent = NULL;
 	child->style  = NULL;
 	child->state  = RTB_STATE_UNATTACHED;
+	memset(child->computed_style, 0, sizeof(child->computed_style));
+
+	if (child->matched_rules.data)
+		VECTOR_CLEAR(&child->matched_rules);
 
-	self->reflow(self, NULL, RTB_DIRECTION_LEAFWARD);
+	if (self->reflow_instigator == child)
+		self->reflow_instigator = NULL;
+
+	if (self->mutation.depth)
+		self->mutation.pending |= RTB_MUTATION_DETACHED;
+	else
+		rtb_elem_trigger_reflow(self, NULL, RTB_DIRECTION_LEAFWARD);
+}
+
+void
+rtb_elem_begin_mutation(struct rtb_element *self)
+{
+	self->mutation.depth++;
+}
+
+void
+rtb_elem_commit_mutation(struct rtb_element *self)
+{
+	unsigned int pending;
+
+	assert(self->mutation.depth > 0);
+
+	if (--self->mutation.depth)
+		return;
+
+	pending = self->mutation.pending;
+	self->mutation.pending = 0;
+
+	if (!pending || self->state == RTB_STATE_UNATTACHED)
+		return;
+
+	/* the new children are still style_stale, so one restyle of the
+	 * parent styles all of them without touching the existing ones. */
+	if (pending & RTB_MUTATION_ATTACHED
+			&& self->window->state != RTB_STATE_UNATTACHED)
+		self->impl->restyle(self);
+
+	/* a removal means everything left has to be laid out again anyway. */
+	if (pending & RTB_MUTATION_DETACHED)
+		rtb_elem_trigger_reflow(self, NULL, RTB_DIRECTION_LEAFWARD);
+	else
+		rtb_elem_trigger_reflow(self, NULL, RTB_DIRECTION_ROOTWARD);
 }
 
-static struct rtb_element_implementation base_impl = {
+void
+rtb_elem_add_children(struct rtb_element *self,
+		struct rtb_element **children, size_t count,
+		rtb_child_add_loc_t where)
+{
+	size_t i;
+
+	rtb_elem_begin_mutation(self);
+
+	if (where == RTB_ADD_HEAD)
+		for (i = count; i > 0; i--)
+			rtb_elem_add_child(self, children[i - 1], RTB_ADD_HEAD);
+	else
+		for (i = 0; i < count; i++)
+			rtb_elem_add_child(self, children[i], RTB_ADD_TAIL);
+
+	rtb_elem_commit_mutation(self);
+}
+
+void
+rtb_elem_remove_children(struct rtb_element *self,
+		struct rtb_element **children, size_t count)
+{
+	size_t i;
+
+	rtb_elem_begin_mutation(self);
+
+	for (i = 0; i < count; i++)
+		rtb_elem_remove_child(self, children[i]);
+
+	rtb_elem_commit_mutation(self);
+}
+
+static void
+free_subtree(struct rtb_element *self)
+{
+	struct rtb_element *iter, *next;
+
+	/* detached() took it off its surface's render queue */
+	assert(!RTB_ELEMENT_IS_MARKED_DIRTY(self));
+
+	for (iter = TAILQ_FIRST(&self->children); iter; iter = next) {
+		next = TAILQ_NEXT(iter, child);
+
+		/* unlink the ones we're about to free, so that nothing is left
+		 * pointing at them when their parent is finalised. */
+		if (iter->release)
+			TAILQ_REMOVE(&self->children, iter, child);
+
+		free_subtree(iter);
+	}
+
+	if (self->release)
+		self->release(self);
+}
+
+void
+rtb_elem_free_subtree(struct rtb_element *self)
+{
+	assert(self->state == RTB_STATE_UNATTACHED);
+	free_subtree(self);
+}
+
+static const struct rtb_element_implementation base_impl = {
 	.draw           = draw,
 	.on_event       = on_event,
 
-	.layout_cb      = rtb_layout_hpack_left,
-	.size_cb        = rtb_size_self,
-
 	.attached       = attached,
 	.detached       = detached,
 
@@ -688,7 +1271,9 @@ rtb_elem_init(struct rtb_element *self)
 	memset(self, 0, sizeof(*self));
 	TAILQ_INIT(&self->children);
 
-	self->impl = base_impl;
+	self->impl      = &base_impl;
+	self->layout_cb = rtb_layout_hpack_left;
+	self->size_cb   = rtb_size_self;
 
 	self->metatype    = RTB_TYPE_ATOM;
 	self->style       = NULL;
@@ -700,13 +1285,17 @@ rtb_elem_init(struct rtb_element *self)
 	self->inner_pad.x = RTB_DEFAULT_INNER_XPAD;
 	self->inner_pad.y = RTB_DEFAULT_INNER_YPAD;
 
-	self->visibility  = RTB_UNOBSCURED;
-	self->window      = NULL;
+	self->layout.shrink = 1.f;
+	self->layout.basis  = -1.f;
+
+	self->visibility      = RTB_UNOBSCURED;
+	self->clip_visibility = RTB_UNOBSCURED;
+	self->window          = NULL;
 
 	self->render_entry.tqe_next = NULL;
 	self->render_entry.tqe_prev = NULL;
 
-	VECTOR_INIT(&self->handlers, &stdlib_allocator, 1);
+	self->handlers.capacity = RTB_INLINE_HANDLERS;
 
 	rtb_stylequad_init(&self->stylequad);
 
@@ -718,7 +1307,18 @@ rtb_elem_init(struct rtb_element *self)
 void
 rtb_elem_fini(struct rtb_element *self)
 {
+	size_t i;
+
+	for (i = 0; i < self->classes.size; i++)
+		free((char *) self->classes.data[i].name);
+
+	if (self->classes.data)
+		VECTOR_FREE(&self->classes);
+	if (self->matched_rules.data)
+		VECTOR_FREE(&self->matched_rules);
+
+	free((char *) self->style_id.name);
+
 	rtb_stylequad_fini(&self->stylequad);
-	VECTOR_FREE(&self->handlers);
-	rtb_type_unref(self->type);
+	slab_allocator.free(self->handlers.spilled);
 }
@@ -27,45 +27,143 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #include <rutabaga/rutabaga.h>
 #include <rutabaga/event.h>
 #include <rutabaga/element.h>
 
-static const struct rtb_event_handler *
-find_handler_for(struct rtb_element *elem, rtb_ev_type_t type)
+#include "rtb_private/slab.h"
+
+static struct rtb_event_handler *
+handler_data(struct rtb_element *elem)
 {
-	struct rtb_event_handler *handlers;
-	int i, size;
+	if (elem->handlers.spilled)
+		return elem->handlers.spilled;
 
-	handlers = elem->handlers.data;
-	size = elem->handlers.size;
+	return elem->handlers.inline_storage;
+}
 
-	for (i = 0; i < size; i++)
-		if (handlers[i].type == type)
-			return &handlers[i];
+static int
+is_builtin(rtb_ev_type_t type)
+{
+	return RTB_IS_SYS_EVENT(type)
+		&& RTB_EVENT_SYS_INDEX(type) < RTB_EVENT_SYS_COUNT;
+}
 
-	return NULL;
+static uint32_t
+user_bit(rtb_ev_type_t type)
+{
+	return 1u << (type % 32);
 }
 
-static int
-replace_handler(struct rtb_element *elem, struct rtb_event_handler *with)
+/* rebuilds the masks and sys_first after the handlers have changed.
+ * that's rare next to how often they're looked up. */
+static void
+reindex_handlers(struct rtb_element *elem)
 {
-	struct rtb_event_handler *handlers;
-	int i, size;
+	struct rtb_handler_list *list = &elem->handlers;
+	struct rtb_event_handler *handlers = handler_data(elem);
+	unsigned int i, index;
+	uint32_t bit;
 
-	handlers = elem->handlers.data;
-	size = elem->handlers.size;
+	list->sys_mask = 0;
+	list->user_mask = 0;
+	memset(list->sys_first, 0, sizeof(list->sys_first));
 
-	for (i = 0; i < size; i++) {
-		/* if there's already a handler defined for this event type,
-		 * replace it. */
-		if (handlers[i].type == with->type) {
-			handlers[i] = *with;
-			return 1;
+	for (i = 0; i < list->size; i++) {
+		if (!is_builtin(handlers[i].type)) {
+			list->user_mask |= user_bit(handlers[i].type);
+			continue;
 		}
+
+		index = RTB_EVENT_SYS_INDEX(handlers[i].type);
+		bit = 1u << index;
+
+		if (!(list->sys_mask & bit) && i < UCHAR_MAX)
+			list->sys_first[index] = i + 1;
+
+		list->sys_mask |= bit;
+	}
+}
+
+/* where to start looking for handlers of `type`, or -1 if there aren't
+ * any. */
+static int
+first_handler_for(struct rtb_element *elem, rtb_ev_type_t type)
+{
+	struct rtb_handler_list *list = &elem->handlers;
+	unsigned int index;
+
+	if (!is_builtin(type))
+		return (list->user_mask & user_bit(type)) ? 0 : -1;
+
+	index = RTB_EVENT_SYS_INDEX(type);
+
+	if (!(list->sys_mask & (1u << index)))
+		return -1;
+
+	return list->sys_first[index] ? list->sys_first[index] - 1 : 0;
+}
+
+/* during a dispatch, the handler is only cleared so that rtb_handle()'s
+ * place in the list stays put. compact_handlers() tidies up after. */
+static void
+remove_handler(struct rtb_element *elem, unsigned int i)
+{
+	struct rtb_event_handler *handlers = handler_data(elem);
+
+	if (elem->handlers.dispatching) {
+		handlers[i].callback.cb = NULL;
+		return;
 	}
 
+	memmove(&handlers[i], &handlers[i + 1],
+			(elem->handlers.size - i - 1) * sizeof(*handlers));
+	elem->handlers.size--;
+}
+
+static void
+compact_handlers(struct rtb_element *elem)
+{
+	struct rtb_event_handler *handlers = handler_data(elem);
+	unsigned int i, kept = 0;
+
+	for (i = 0; i < elem->handlers.size; i++)
+		if (handlers[i].callback.cb)
+			handlers[kept++] = handlers[i];
+
+	if (kept == elem->handlers.size)
+		return;
+
+	elem->handlers.size = kept;
+	reindex_handlers(elem);
+}
+
+static int
+append_handler(struct rtb_element *elem, struct rtb_event_handler *handler)
+{
+	struct rtb_handler_list *list = &elem->handlers;
+	struct rtb_event_handler *grown;
+
+	if (!list->capacity)
+		list->capacity = RTB_INLINE_HANDLERS;
+
+	if (list->size == list->capacity) {
+		grown = slab_allocator.malloc(
+				list->capacity * 2 * sizeof(*grown));
+
+		if (!grown)
+			return -1;
+
+		memcpy(grown, handler_data(elem), list->size * sizeof(*grown));
+		slab_allocator.free(list->spilled);
+
+		list->spilled = grown;
+		list->capacity *= 2;
+	}
+
+	handler_data(elem)[list->size++] = *handler;
 	return 0;
 }
 
@@ -76,12 +174,31 @@ replace_handler(struct rtb_element *elem, struct rtb_event_handler *with)
 int
 rtb_handle(struct rtb_element *target, const struct rtb_event *event)
 {
-	const struct rtb_event_handler *h;
+	struct rtb_event_handler h;
+	int i, ret = -1;
 
-	if (!(h = find_handler_for(target, event->type)))
+	if ((i = first_handler_for(target, event->type)) < 0)
 		return -1;
 
-	return h->callback.cb(target, event, h->callback.ctx);
+	/* a handler can register others, which might move the list, so we
+	 * go back to it each time round. unregistering only clears the
+	 * callback until we're done, so the indices don't shift under us. */
+	target->handlers.dispatching++;
+
+	for (; i < (int) target->handlers.size; i++) {
+		h = handler_data(target)[i];
+
+		if (h.type != event->type || !h.callback.cb)
+			continue;
+
+		if ((ret = h.callback.cb(target, event, h.callback.ctx)))
+			break;
+	}
+
+	if (!--target->handlers.dispatching)
+		compact_handlers(target);
+
+	return ret;
 }
 
 struct rtb_element *
@@ -116,27 +233,49 @@ rtb_register_handler(struct rtb_element *target, rtb_ev_type_t type,
 	assert(target);
 	assert(cb);
 
-	if (!replace_handler(target, &handler))
-		VECTOR_PUSH_BACK(&target->handlers, &handler);
+	if (append_handler(target, &handler))
+		return -1;
 
+	reindex_handlers(target);
 	return 0;
 }
 
 void
 rtb_unregister_handler(struct rtb_element *target, rtb_ev_type_t type)
 {
-	const struct rtb_event_handler *handlers;
-	int i, size;
+	struct rtb_event_handler *handlers;
+	unsigned int i;
 
 	assert(target);
 
-	handlers = target->handlers.data;
-	size = target->handlers.size;
+	handlers = handler_data(target);
+
+	for (i = target->handlers.size; i > 0; i--)
+		if (handlers[i - 1].type == type && handlers[i - 1].callback.cb)
+			remove_handler(target, i - 1);
 
-	for (i = 0; i < size; i++) {
-		if (handlers[i].type == type) {
-			VECTOR_ERASE(&target->handlers, i);
-			return;
+	reindex_handlers(target);
+}
+
+void
+rtb_unregister_handler_cb(struct rtb_element *target, rtb_ev_type_t type,
+		rtb_event_cb_t cb, void *user_arg)
+{
+	struct rtb_event_handler *handlers;
+	unsigned int i;
+
+	assert(target);
+
+	handlers = handler_data(target);
+
+	for (i = 0; i < target->handlers.size; i++) {
+		if (handlers[i].type == type
+				&& handlers[i].callback.cb == cb
+				&& handlers[i].callback.ctx == user_arg) {
+			remove_handler(target, i);
+			break;
 		}
 	}
+
+	reindex_handlers(target);
 }
@@ -0,0 +1,526 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include <rutabaga/rutabaga.h>
+#include <rutabaga/element.h>
+#include <rutabaga/geometry.h>
+
+#include "rtb_private/geometry-store.h"
+
+#define INITIAL_CAPACITY 64
+
+/* how many children a slot needs before hit-testing it goes through a
+ * grid, roughly how many children we aim to put in each cell, and the
+ * most cells along each side. */
+#define GRID_MIN_CHILDREN  32
+#define GRID_CELL_CHILDREN 4
+#define GRID_MAX_SIDE      256
+
+struct rtb_child_grid {
+	int stale;
+
+	float x, y, x2, y2;
+	float cell_w, cell_h;
+	unsigned int cols, rows;
+
+	/* the children overlapping cell i are entries[start[i]] up to
+	 * entries[start[i + 1]], in sibling order. */
+	unsigned int *start;
+	unsigned int *entries;
+	unsigned int start_capacity;
+	unsigned int entries_capacity;
+};
+
+/**
+ * storage
+ */
+
+#define GROW_ARRAY(self, field, capacity) do {							\
+	void *grown = realloc((self)->field,								\
+			(capacity) * sizeof(*(self)->field));						\
+	if (!grown)															\
+		return -1;														\
+	(self)->field = grown;												\
+} while (0)
+
+static int
+grow(struct rtb_geometry_store *self)
+{
+	unsigned int capacity = self->capacity * 2;
+
+	GROW_ARRAY(self, x, capacity);
+	GROW_ARRAY(self, y, capacity);
+	GROW_ARRAY(self, x2, capacity);
+	GROW_ARRAY(self, y2, capacity);
+	GROW_ARRAY(self, visibility, capacity);
+
+	GROW_ARRAY(self, parent, capacity);
+	GROW_ARRAY(self, first_child, capacity);
+	GROW_ARRAY(self, last_child, capacity);
+	GROW_ARRAY(self, prev_sibling, capacity);
+	GROW_ARRAY(self, next_sibling, capacity);
+	GROW_ARRAY(self, child_count, capacity);
+
+	GROW_ARRAY(self, grid, capacity);
+	GROW_ARRAY(self, element, capacity);
+
+	self->capacity = capacity;
+	return 0;
+}
+
+/* freed slots are chained through next_sibling. */
+static unsigned int
+alloc_slot(struct rtb_geometry_store *self)
+{
+	unsigned int slot;
+
+	if (self->free_slot) {
+		slot = self->free_slot;
+		self->free_slot = self->next_sibling[slot];
+		return slot;
+	}
+
+	if (self->size == self->capacity && grow(self))
+		return 0;
+
+	return self->size++;
+}
+
+/**
+ * child grid
+ */
+
+static void
+grid_free(struct rtb_child_grid *grid)
+{
+	if (!grid)
+		return;
+
+	free(grid->start);
+	free(grid->entries);
+	free(grid);
+}
+
+static void
+invalidate_grid(struct rtb_geometry_store *self, unsigned int slot)
+{
+	if (slot && self->grid[slot])
+		self->grid[slot]->stale = 1;
+}
+
+static int
+reserve(unsigned int **array, unsigned int *capacity, unsigned int want)
+{
+	unsigned int *grown;
+
+	if (want <= *capacity)
+		return 0;
+
+	if (!(grown = realloc(*array, want * sizeof(**array))))
+		return -1;
+
+	*array = grown;
+	*capacity = want;
+	return 0;
+}
+
+static unsigned int
+cell_of(float v, float origin, float cell_size, unsigned int cells)
+{
+	float cell = floorf((v - origin) / cell_size);
+
+	if (cell < 0.f)
+		return 0;
+	if (cell >= (float) cells)
+		return cells - 1;
+	return (unsigned int) cell;
+}
+
+/* the cells a slot's rect overlaps, inclusive */
+struct cell_range {
+	unsigned int row, row_end;
+	unsigned int col, col_end;
+};
+
+static void
+cells_covered(const struct rtb_child_grid *grid,
+		const struct rtb_geometry_store *self, unsigned int slot,
+		struct cell_range *range)
+{
+	range->row     = cell_of(self->y[slot],  grid->y, grid->cell_h, grid->rows);
+	range->row_end = cell_of(self->y2[slot], grid->y, grid->cell_h, grid->rows);
+	range->col     = cell_of(self->x[slot],  grid->x, grid->cell_w, grid->cols);
+	range->col_end = cell_of(self->x2[slot], grid->x, grid->cell_w, grid->cols);
+}
+
+static int
+build_grid(struct rtb_geometry_store *self, unsigned int slot)
+{
+	struct rtb_child_grid *grid = self->grid[slot];
+	unsigned int iter, row, col, cell, cells, side, n = 0;
+	struct cell_range range;
+	float x = INFINITY, y = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+
+	if (!grid && !(grid = self->grid[slot] = calloc(1, sizeof(*grid))))
+		return -1;
+
+	for (iter = self->first_child[slot]; iter;
+			iter = self->next_sibling[iter]) {
+		if (self->visibility[iter] == RTB_FULLY_OBSCURED)
+			continue;
+
+		x  = fminf(x,  self->x[iter]);
+		y  = fminf(y,  self->y[iter]);
+		x2 = fmaxf(x2, self->x2[iter]);
+		y2 = fmaxf(y2, self->y2[iter]);
+		n++;
+	}
+
+	grid->cols = grid->rows = 0;
+	grid->stale = 0;
+
+	if (!n)
+		return 0;
+
+	side = (unsigned int) sqrtf((float) n / GRID_CELL_CHILDREN);
+	if (side < 1)
+		side = 1;
+	else if (side > GRID_MAX_SIDE)
+		side = GRID_MAX_SIDE;
+
+	cells = side * side;
+
+	grid->x  = x;
+	grid->y  = y;
+	grid->x2 = x2;
+	grid->y2 = y2;
+	grid->cell_w = (x2 > x) ? (x2 - x) / side : 1.f;
+	grid->cell_h = (y2 > y) ? (y2 - y) / side : 1.f;
+
+	if (reserve(&grid->start, &grid->start_capacity, cells + 1))
+		goto err;
+
+	grid->cols = grid->rows = side;
+	memset(grid->start, 0, (cells + 1) * sizeof(*grid->start));
+
+	/* count what lands in each cell, one place along, so that a running
+	 * sum turns the counts into where each cell starts. */
+	for (iter = self->first_child[slot]; iter;
+			iter = self->next_sibling[iter]) {
+		if (self->visibility[iter] == RTB_FULLY_OBSCURED)
+			continue;
+
+		cells_covered(grid, self, iter, &range);
+
+		for (row = range.row; row <= range.row_end; row++)
+			for (col = range.col; col <= range.col_end; col++)
+				grid->start[row * side + col + 1]++;
+	}
+
+	for (cell = 0; cell < cells; cell++)
+		grid->start[cell + 1] += grid->start[cell];
+
+	if (reserve(&grid->entries, &grid->entries_capacity,
+				grid->start[cells]))
+		goto err;
+
+	/* fill each cell using its start as a cursor. afterwards, start[i]
+	 * has moved on to where cell i + 1 starts, so shift everything back
+	 * along by one. */
+	for (iter = self->first_child[slot]; iter;
+			iter = self->next_sibling[iter]) {
+		if (self->visibility[iter] == RTB_FULLY_OBSCURED)
+			continue;
+
+		cells_covered(grid, self, iter, &range);
+
+		for (row = range.row; row <= range.row_end; row++)
+			for (col = range.col; col <= range.col_end; col++)
+				grid->entries[grid->start[row * side + col]++] = iter;
+	}
+
+	memmove(grid->start + 1, grid->start, cells * sizeof(*grid->start));
+	grid->start[0] = 0;
+
+	return 0;
+
+err:
+	grid->cols = grid->rows = 0;
+	grid->stale = 1;
+	return -1;
+}
+
+static int
+in_slot(const struct rtb_geometry_store *self, unsigned int slot,
+		struct rtb_point pt)
+{
+	return pt.x >= self->x[slot] && pt.x <= self->x2[slot]
+		&& pt.y >= self->y[slot] && pt.y <= self->y2[slot]
+		&& self->visibility[slot] != RTB_FULLY_OBSCURED;
+}
+
+static unsigned int
+grid_child_at(struct rtb_geometry_store *self, unsigned int slot,
+		struct rtb_point pt)
+{
+	struct rtb_child_grid *grid = self->grid[slot];
+	unsigned int i, cell;
+
+	if (!grid->cols
+			|| pt.x < grid->x || pt.x > grid->x2
+			|| pt.y < grid->y || pt.y > grid->y2)
+		return 0;
+
+	cell = cell_of(pt.y, grid->y, grid->cell_h, grid->rows) * grid->cols
+		+ cell_of(pt.x, grid->x, grid->cell_w, grid->cols);
+
+	/* later children draw on top, so they get first refusal */
+	for (i = grid->start[cell + 1]; i > grid->start[cell]; i--)
+		if (in_slot(self, grid->entries[i - 1], pt))
+			return grid->entries[i - 1];
+
+	return 0;
+}
+
+/**
+ * tree
+ */
+
+static void
+link_after(struct rtb_geometry_store *self, unsigned int parent,
+		unsigned int prev, unsigned int slot)
+{
+	unsigned int next = prev ? self->next_sibling[prev]
+		: self->first_child[parent];
+
+	self->parent[slot] = parent;
+	self->prev_sibling[slot] = prev;
+	self->next_sibling[slot] = next;
+
+	self->child_count[parent]++;
+	invalidate_grid(self, parent);
+
+	if (prev)
+		self->next_sibling[prev] = slot;
+	else
+		self->first_child[parent] = slot;
+
+	if (next)
+		self->prev_sibling[next] = slot;
+	else
+		self->last_child[parent] = slot;
+}
+
+static void
+unlink_slot(struct rtb_geometry_store *self, unsigned int slot)
+{
+	unsigned int parent = self->parent[slot],
+				 prev = self->prev_sibling[slot],
+				 next = self->next_sibling[slot];
+
+	if (prev)
+		self->next_sibling[prev] = next;
+	else if (parent)
+		self->first_child[parent] = next;
+
+	if (next)
+		self->prev_sibling[next] = prev;
+	else if (parent)
+		self->last_child[parent] = prev;
+
+	if (parent) {
+		self->child_count[parent]--;
+		invalidate_grid(self, parent);
+	}
+}
+
+/**
+ * public API
+ */
+
+int
+rtb_geometry_store_attach(struct rtb_geometry_store *self,
+		struct rtb_element *elem)
+{
+	struct rtb_element *prev;
+	unsigned int slot, parent = 0;
+
+	/* the window re-attaches the whole tree when it's reinitialised,
+	 * without detaching it first. nothing has moved in the tree. */
+	if (elem->geometry_slot) {
+		rtb_geometry_store_sync(self, elem);
+		return 0;
+	}
+
+	if (!(slot = alloc_slot(self)))
+		return -1;
+
+	self->element[slot] = elem;
+	self->first_child[slot] = self->last_child[slot] = 0;
+	self->parent[slot] = self->prev_sibling[slot] = self->next_sibling[slot] = 0;
+	self->child_count[slot] = 0;
+	self->grid[slot] = NULL;
+
+	elem->geometry_slot = slot;
+	rtb_geometry_store_sync(self, elem);
+
+	if (elem->parent && elem->parent != elem)
+		parent = elem->parent->geometry_slot;
+
+	if (!parent)
+		return 0;
+
+	/* siblings are attached in tree order, so the one before us
+	 * already has a slot if there is one. */
+	prev = TAILQ_PREV(elem, children, child);
+	link_after(self, parent, prev ? prev->geometry_slot : 0, slot);
+
+	return 0;
+}
+
+void
+rtb_geometry_store_detach(struct rtb_geometry_store *self,
+		struct rtb_element *elem)
+{
+	unsigned int slot = elem->geometry_slot;
+
+	if (!slot)
+		return;
+
+	unlink_slot(self, slot);
+
+	grid_free(self->grid[slot]);
+	self->grid[slot] = NULL;
+
+	self->element[slot] = NULL;
+	self->next_sibling[slot] = self->free_slot;
+	self->free_slot = slot;
+
+	elem->geometry_slot = 0;
+}
+
+void
+rtb_geometry_store_sync(struct rtb_geometry_store *self,
+		struct rtb_element *elem)
+{
+	unsigned int slot = elem->geometry_slot;
+
+	rtb_visibility_t visibility = rtb_elem_visibility(elem);
+
+	if (!slot)
+		return;
+
+	/* reflow syncs everything it touches, most of which hasn't moved.
+	 * don't throw the parent's grid away for those. */
+	if (self->x[slot] == elem->x && self->y[slot] == elem->y
+			&& self->x2[slot] == elem->x2 && self->y2[slot] == elem->y2
+			&& self->visibility[slot] == visibility)
+		return;
+
+	self->x[slot]  = elem->x;
+	self->y[slot]  = elem->y;
+	self->x2[slot] = elem->x2;
+	self->y2[slot] = elem->y2;
+	self->visibility[slot] = visibility;
+
+	invalidate_grid(self, self->parent[slot]);
+}
+
+unsigned int
+rtb_geometry_store_child_at(struct rtb_geometry_store *self,
+		unsigned int slot, struct rtb_point pt)
+{
+	struct rtb_child_grid *grid = self->grid[slot];
+	unsigned int iter;
+
+	if (self->child_count[slot] >= GRID_MIN_CHILDREN) {
+		if ((grid && !grid->stale) || !build_grid(self, slot))
+			return grid_child_at(self, slot, pt);
+
+		/* couldn't allocate the grid. fall back to scanning. */
+	}
+
+	/* later children draw on top, so they get first refusal */
+	for (iter = self->last_child[slot]; iter;
+			iter = self->prev_sibling[iter])
+		if (in_slot(self, iter, pt))
+			return iter;
+
+	return 0;
+}
+
+struct rtb_geometry_store *
+rtb_geometry_store_new(void)
+{
+	struct rtb_geometry_store *self;
+
+	if (!(self = calloc(1, sizeof(*self))))
+		return NULL;
+
+	/* grow() doubles, and slot 0 is taken up front */
+	self->capacity = INITIAL_CAPACITY / 2;
+	if (grow(self))
+		goto err_grow;
+
+	self->size = 1;
+	return self;
+
+err_grow:
+	rtb_geometry_store_free(self);
+	return NULL;
+}
+
+void
+rtb_geometry_store_free(struct rtb_geometry_store *self)
+{
+	unsigned int slot;
+
+	free(self->x);
+	free(self->y);
+	free(self->x2);
+	free(self->y2);
+	free(self->visibility);
+
+	free(self->parent);
+	free(self->first_child);
+	free(self->last_child);
+	free(self->prev_sibling);
+	free(self->next_sibling);
+	free(self->child_count);
+
+	/* slots on the free list have already had their grid freed */
+	for (slot = 1; slot < self->size; slot++)
+		grid_free(self->grid[slot]);
+
+	free(self->grid);
+	free(self->element);
+	free(self);
+}
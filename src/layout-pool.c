@@ -0,0 +1,252 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <uv.h>
+
+#include <rutabaga/rutabaga.h>
+#include <rutabaga/element.h>
+
+#include "rtb_private/layout-pool.h"
+#include "rtb_private/stdlib-allocator.h"
+
+#include "wwrl/vector.h"
+
+/* the main thread works through the batch too, so this is on top of it */
+#define MAX_WORKERS 15
+
+/* how many subtrees to aim for per thread, so that one big subtree
+ * doesn't leave the rest of the threads idle. */
+#define SUBTREES_PER_THREAD 4
+
+/**
+ * workers
+ */
+
+/* takes subtrees off the current batch until there are none left.
+ * called and returns with the lock held. */
+static void
+work_through_batch(struct rtb_layout_pool *self)
+{
+	struct rtb_element *subtree;
+
+	while (self->next_subtree < self->nsubtrees) {
+		subtree = self->subtrees[self->next_subtree++];
+
+		uv_mutex_unlock(&self->lock);
+		self->job(subtree);
+		uv_mutex_lock(&self->lock);
+
+		if (++self->subtrees_done == self->nsubtrees)
+			uv_cond_signal(&self->work_done);
+	}
+}
+
+static void
+worker(void *ctx)
+{
+	struct rtb_layout_pool *self = ctx;
+
+	uv_mutex_lock(&self->lock);
+
+	while (!self->shutting_down) {
+		if (self->next_subtree < self->nsubtrees)
+			work_through_batch(self);
+		else
+			uv_cond_wait(&self->work_ready, &self->lock);
+	}
+
+	uv_mutex_unlock(&self->lock);
+}
+
+static void
+run_batch(struct rtb_layout_pool *self, rtb_layout_job_t job,
+		struct rtb_element **subtrees, size_t nsubtrees)
+{
+	uv_mutex_lock(&self->lock);
+
+	self->job = job;
+	self->subtrees = subtrees;
+	self->nsubtrees = nsubtrees;
+	self->next_subtree = 0;
+	self->subtrees_done = 0;
+
+	uv_cond_broadcast(&self->work_ready);
+	work_through_batch(self);
+
+	while (self->subtrees_done < self->nsubtrees)
+		uv_cond_wait(&self->work_done, &self->lock);
+
+	self->subtrees = NULL;
+	self->nsubtrees = self->next_subtree = 0;
+
+	uv_mutex_unlock(&self->lock);
+}
+
+/**
+ * layout
+ */
+
+static void
+lay_out_subtree(struct rtb_element *elem)
+{
+	struct rtb_element *iter;
+
+	rtb_elem_layout_geometry(elem);
+
+	TAILQ_FOREACH(iter, &elem->children, child)
+		lay_out_subtree(iter);
+}
+
+void
+rtb_layout_pool_lay_out(struct rtb_layout_pool *self,
+		struct rtb_element *root)
+{
+	VECTOR(frontier, struct rtb_element *) frontier = {NULL};
+	struct rtb_element *elem, *iter;
+	size_t i, want;
+
+	want = (self->nthreads + 1) * SUBTREES_PER_THREAD;
+	VECTOR_INIT(&frontier, &stdlib_allocator, want);
+	VECTOR_PUSH_BACK(&frontier, &root);
+
+	/* split the tree until there are enough independent subtrees to go
+	 * around. the elements we split on are laid out here, first, since
+	 * their children's slots depend on them. */
+	for (i = 0; i < frontier.size && frontier.size < want;) {
+		elem = frontier.data[i];
+
+		if (TAILQ_EMPTY(&elem->children)) {
+			i++;
+			continue;
+		}
+
+		rtb_elem_layout_geometry(elem);
+		VECTOR_ERASE(&frontier, i);
+
+		TAILQ_FOREACH(iter, &elem->children, child)
+			VECTOR_PUSH_BACK(&frontier, &iter);
+	}
+
+	if (frontier.size)
+		run_batch(self, lay_out_subtree, frontier.data, frontier.size);
+
+	VECTOR_FREE(&frontier);
+}
+
+/**
+ * public API
+ */
+
+static int
+count_cpus(void)
+{
+	uv_cpu_info_t *cpus;
+	int count;
+
+	if (uv_cpu_info(&cpus, &count))
+		return 1;
+
+	uv_free_cpu_info(cpus, count);
+	return count;
+}
+
+struct rtb_layout_pool *
+rtb_layout_pool_new(void)
+{
+	struct rtb_layout_pool *self;
+	int nworkers, i;
+
+	nworkers = count_cpus() - 1;
+	if (nworkers > MAX_WORKERS)
+		nworkers = MAX_WORKERS;
+
+	if (nworkers < 1)
+		return NULL;
+
+	if (!(self = calloc(1, sizeof(*self))))
+		return NULL;
+
+	if (!(self->threads = calloc(nworkers, sizeof(*self->threads))))
+		goto err_threads;
+
+	if (uv_mutex_init(&self->lock))
+		goto err_mutex;
+
+	if (uv_cond_init(&self->work_ready))
+		goto err_work_ready;
+
+	if (uv_cond_init(&self->work_done))
+		goto err_work_done;
+
+	for (i = 0; i < nworkers; i++) {
+		if (uv_thread_create(&self->threads[i], worker, self))
+			break;
+
+		self->nthreads++;
+	}
+
+	if (!self->nthreads) {
+		rtb_layout_pool_free(self);
+		return NULL;
+	}
+
+	return self;
+
+err_work_done:
+	uv_cond_destroy(&self->work_ready);
+err_work_ready:
+	uv_mutex_destroy(&self->lock);
+err_mutex:
+	free(self->threads);
+err_threads:
+	free(self);
+	return NULL;
+}
+
+void
+rtb_layout_pool_free(struct rtb_layout_pool *self)
+{
+	int i;
+
+	uv_mutex_lock(&self->lock);
+	self->shutting_down = 1;
+	uv_cond_broadcast(&self->work_ready);
+	uv_mutex_unlock(&self->lock);
+
+	for (i = 0; i < self->nthreads; i++)
+		uv_thread_join(&self->threads[i]);
+
+	uv_cond_destroy(&self->work_done);
+	uv_cond_destroy(&self->work_ready);
+	uv_mutex_destroy(&self->lock);
+
+	free(self->threads);
+	free(self);
+}
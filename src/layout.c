@@ -403,3 +403,319 @@ rtb_layout_hdistribute(struct rtb_element *elem)
 		return hdistribute_many(elem, children, child0_width, children_width);
 	}
 }
+
+/**
+ * flex
+ */
+
+struct flex_line {
+	int count;
+
+	/* the children's bases plus the padding between them */
+	float basis;
+	float cross;
+
+	float grow;
+	float shrink;
+};
+
+static float
+flex_basis(struct rtb_element *child, const struct rtb_size *measured,
+		int horizontal)
+{
+	if (child->layout.basis >= 0.f)
+		return child->layout.basis;
+
+	return horizontal ? measured->w : measured->h;
+}
+
+/* gathers the children from `first` onward that fit on one line, and
+ * returns the first child of the next line (NULL if there isn't one). */
+static struct rtb_element *
+flex_gather_line(struct rtb_element *elem, struct rtb_element *first,
+		const struct rtb_size *avail, int horizontal, struct flex_line *line)
+{
+	float pad, avail_main, basis, used;
+	struct rtb_element *iter;
+	struct rtb_size child;
+
+	pad = horizontal ? elem->inner_pad.x : elem->inner_pad.y;
+	avail_main = horizontal ? avail->w : avail->h;
+
+	line->count  = 0;
+	line->basis  = 0.f;
+	line->cross  = 0.f;
+	line->grow   = 0.f;
+	line->shrink = 0.f;
+
+	for (iter = first; iter; iter = TAILQ_NEXT(iter, child)) {
+		rtb_elem_request_size(iter, avail, &child);
+		basis = flex_basis(iter, &child, horizontal);
+		used  = line->basis + basis + (line->count ? pad : 0.f);
+
+		if (elem->layout.wrap && line->count
+				&& avail_main > 0.f && used > avail_main)
+			break;
+
+		line->basis   = used;
+		line->cross   = fmax(line->cross, horizontal ? child.h : child.w);
+		line->grow   += iter->layout.grow;
+		line->shrink += iter->layout.shrink * basis;
+		line->count++;
+	}
+
+	return iter;
+}
+
+static void
+flex_size(struct rtb_element *elem, const struct rtb_size *avail,
+		struct rtb_size *want, int horizontal)
+{
+	struct rtb_size inner, need;
+	struct rtb_element *iter;
+	struct flex_line line;
+	float main, cross, cross_pad;
+
+	inner.w = fmax(avail->w - (elem->outer_pad.x * 2), 0.f);
+	inner.h = fmax(avail->h - (elem->outer_pad.y * 2), 0.f);
+
+	cross_pad = horizontal ? elem->inner_pad.y : elem->inner_pad.x;
+	main = cross = 0.f;
+
+	for (iter = TAILQ_FIRST(&elem->children); iter;) {
+		iter = flex_gather_line(elem, iter, &inner, horizontal, &line);
+
+		main   = fmax(main, line.basis);
+		cross += line.cross + (iter ? cross_pad : 0.f);
+	}
+
+	need.w = (horizontal ? main : cross) + (elem->outer_pad.x * 2);
+	need.h = (horizontal ? cross : main) + (elem->outer_pad.y * 2);
+
+	want->w = fmax(need.w, elem->min_size.w);
+	want->h = fmax(need.h, elem->min_size.h);
+}
+
+static void
+flex_layout(struct rtb_element *elem, int horizontal)
+{
+	float pad, cross_pad, main, basis, slack, pos, cross_pos;
+	struct rtb_element *iter, *next;
+	struct rtb_size avail, child;
+	struct rtb_point position;
+	struct flex_line line;
+	int i;
+
+	avail = elem->inner_rect.size;
+
+	pad       = horizontal ? elem->inner_pad.x : elem->inner_pad.y;
+	cross_pad = horizontal ? elem->inner_pad.y : elem->inner_pad.x;
+	cross_pos = horizontal ? elem->inner_rect.y : elem->inner_rect.x;
+
+	for (iter = TAILQ_FIRST(&elem->children); iter; iter = next) {
+		next = flex_gather_line(elem, iter, &avail, horizontal, &line);
+		slack = (horizontal ? avail.w : avail.h) - line.basis;
+
+		/* a single line gets the whole cross axis to align within */
+		if (!elem->layout.wrap)
+			line.cross = horizontal ? avail.h : avail.w;
+
+		pos = horizontal ? elem->inner_rect.x : elem->inner_rect.y;
+
+		for (i = 0; i < line.count; i++, iter = TAILQ_NEXT(iter, child)) {
+			rtb_elem_request_size(iter, &avail, &child);
+			basis = flex_basis(iter, &child, horizontal);
+
+			if (slack > 0.f && line.grow > 0.f)
+				main = basis + slack * (iter->layout.grow / line.grow);
+			else if (slack < 0.f && line.shrink > 0.f)
+				main = basis +
+					slack * (iter->layout.shrink * basis / line.shrink);
+			else
+				main = basis;
+
+			if (horizontal) {
+				child.w = fmax(main, iter->min_size.w);
+				position.x = pos;
+				position.y = cross_pos +
+					valign(line.cross, child.h, iter->align);
+			} else {
+				child.h = fmax(main, iter->min_size.h);
+				position.x = cross_pos +
+					halign(line.cross, child.w, iter->align);
+				position.y = pos;
+			}
+
+			rtb_elem_set_position_from_point(iter, &position);
+			rtb_elem_set_size(iter, &child);
+
+			pos += (horizontal ? child.w : child.h) + pad;
+		}
+
+		cross_pos += line.cross + cross_pad;
+	}
+}
+
+void
+rtb_size_hflex(struct rtb_element *elem,
+		const struct rtb_size *avail, struct rtb_size *want)
+{
+	flex_size(elem, avail, want, 1);
+}
+
+void
+rtb_size_vflex(struct rtb_element *elem,
+		const struct rtb_size *avail, struct rtb_size *want)
+{
+	flex_size(elem, avail, want, 0);
+}
+
+void
+rtb_layout_hflex(struct rtb_element *elem)
+{
+	flex_layout(elem, 1);
+}
+
+void
+rtb_layout_vflex(struct rtb_element *elem)
+{
+	flex_layout(elem, 0);
+}
+
+/**
+ * grid
+ */
+
+static int
+grid_columns(struct rtb_element *elem)
+{
+	if (elem->layout.columns > RTB_LAYOUT_GRID_MAX_COLUMNS)
+		return RTB_LAYOUT_GRID_MAX_COLUMNS;
+
+	return (elem->layout.columns > 0) ? elem->layout.columns : 1;
+}
+
+/* measures every child once, widening each column to fit. returns the
+ * total height of the rows. */
+static float
+grid_measure(struct rtb_element *elem, const struct rtb_size *avail,
+		float *col_w, int columns)
+{
+	float rows_h, row_h;
+	struct rtb_element *iter;
+	struct rtb_size child;
+	int col;
+
+	rows_h = row_h = 0.f;
+
+	for (col = 0; col < columns; col++)
+		col_w[col] = 0.f;
+
+	col = 0;
+	TAILQ_FOREACH(iter, &elem->children, child) {
+		rtb_elem_request_size(iter, avail, &child);
+
+		col_w[col] = fmax(col_w[col], child.w);
+		row_h = fmax(row_h, child.h);
+
+		if (++col == columns) {
+			rows_h += row_h + elem->inner_pad.y;
+			row_h = 0.f;
+			col = 0;
+		}
+	}
+
+	if (col)
+		rows_h += row_h + elem->inner_pad.y;
+
+	return fmax(rows_h - elem->inner_pad.y, 0.f);
+}
+
+static float
+grid_width(struct rtb_element *elem, const float *col_w, int columns)
+{
+	float w = -elem->inner_pad.x;
+	int col;
+
+	for (col = 0; col < columns; col++)
+		w += col_w[col] + elem->inner_pad.x;
+
+	return fmax(w, 0.f);
+}
+
+void
+rtb_size_grid(struct rtb_element *elem,
+		const struct rtb_size *avail, struct rtb_size *want)
+{
+	int columns = grid_columns(elem);
+	struct rtb_size need, zero = {0.f, 0.f};
+	float col_w[RTB_LAYOUT_GRID_MAX_COLUMNS];
+
+	need.h = grid_measure(elem, &zero, col_w, columns);
+	need.w = grid_width(elem, col_w, columns);
+
+	need.w += elem->outer_pad.x * 2;
+	need.h += elem->outer_pad.y * 2;
+
+	want->w = fmax(need.w, elem->min_size.w);
+	want->h = fmax(need.h, elem->min_size.h);
+}
+
+void
+rtb_layout_grid(struct rtb_element *elem)
+{
+	int columns = grid_columns(elem), col;
+	struct rtb_element *iter, *row_iter;
+	struct rtb_size avail, child, zero = {0.f, 0.f};
+	struct rtb_point position;
+	float col_w[RTB_LAYOUT_GRID_MAX_COLUMNS], extra, row_h, x, y;
+
+	avail = elem->inner_rect.size;
+
+	/* measured the same way as rtb_size_grid() does, so that the two
+	 * agree. a child that wants more room gets it through layout.grow
+	 * and the leftover width below. */
+	grid_measure(elem, &zero, col_w, columns);
+
+	extra = (avail.w - grid_width(elem, col_w, columns)) / columns;
+	if (extra > 0.f)
+		for (col = 0; col < columns; col++)
+			col_w[col] += extra;
+
+	y = elem->inner_rect.y;
+	iter = TAILQ_FIRST(&elem->children);
+
+	while (iter) {
+		row_h = 0.f;
+		row_iter = iter;
+
+		/* the children were all measured above, so this is cheap */
+		for (col = 0; row_iter && col < columns;
+				col++, row_iter = TAILQ_NEXT(row_iter, child)) {
+			rtb_elem_request_size(row_iter, &zero, &child);
+			row_h = fmax(row_h, child.h);
+		}
+
+		x = elem->inner_rect.x;
+
+		for (col = 0; iter && col < columns;
+				col++, iter = TAILQ_NEXT(iter, child)) {
+			rtb_elem_request_size(iter, &zero, &child);
+
+			if (iter->layout.grow > 0.f) {
+				child.w = col_w[col];
+				child.h = row_h;
+			}
+
+			position.x = x + halign(col_w[col], child.w, iter->align);
+			position.y = y + valign(row_h, child.h, iter->align);
+
+			rtb_elem_set_position_from_point(iter, &position);
+			rtb_elem_set_size(iter, &child);
+
+			x += col_w[col] + elem->inner_pad.x;
+		}
+
+		y += row_h + elem->inner_pad.y;
+	}
+}
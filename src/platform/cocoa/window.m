@@ -188,6 +188,32 @@ reinit_tracking_area(RutabagaOpenGLView *self, NSTrackingArea *tracking_area)
 	UNLOCK;
 }
 
+- (void) viewDidChangeBackingProperties
+{
+	NSSize size, phy_size;
+
+	[super viewDidChangeBackingProperties];
+
+	if (!rtb_win)
+		return;
+
+	size = [self bounds].size;
+	if (!size.width || !size.height)
+		return;
+
+	phy_size = [self convertSizeToBacking:size];
+
+	rtb_win->phy_size.w = phy_size.width;
+	rtb_win->phy_size.h = phy_size.height;
+
+	LOCK;
+	[rtb_win->gl_ctx update];
+	rtb_window_set_scale(RTB_WINDOW(rtb_win), RTB_MAKE_POINT(
+			phy_size.width / size.width,
+			phy_size.height / size.height));
+	UNLOCK;
+}
+
 - (void) drawRect: (NSRect) dirtyRect
 {
 	if (!rtb_win)
@@ -345,7 +371,7 @@ app_kit_button_to_rtb_button(const NSEvent *e)
 			.window = RTB_WINDOW(rtb_win)
 		};
 
-		rtb_win->on_event(RTB_ELEMENT(rtb_win), RTB_EVENT(&ev));
+		rtb_win->impl->on_event(RTB_ELEMENT(rtb_win), RTB_EVENT(&ev));
 	}
 }
 
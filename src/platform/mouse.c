@@ -24,6 +24,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
 #include <uv.h>
 
 #include <rutabaga/rutabaga.h>
@@ -32,6 +33,8 @@
 #include <rutabaga/mouse.h>
 #include <rutabaga/platform.h>
 
+#include "rtb_private/geometry-store.h"
+
 /**
  * event dispatching
  */
@@ -281,11 +284,13 @@ element_underneath_mouse(struct rtb_window *win)
 static void
 retarget(struct rtb_window *win, struct rtb_point cursor)
 {
-	struct rtb_element *iter, *ret = element_underneath_mouse(win);
+	struct rtb_geometry_store *geom = win->geometry;
+	struct rtb_element *ret = element_underneath_mouse(win);
+	unsigned int slot;
 
 	while (ret != (struct rtb_element *) win) {
 		if (RTB_POINT_IN_RECT(cursor, *ret)
-				&& ret->visibility != RTB_FULLY_OBSCURED)
+				&& rtb_elem_visibility(ret) != RTB_FULLY_OBSCURED)
 			break;
 
 		ret->mouse_in = 0;
@@ -297,20 +302,20 @@ retarget(struct rtb_window *win, struct rtb_point cursor)
 		ret = ret->parent;
 	}
 
-descend:
-	TAILQ_FOREACH_REVERSE(iter, &ret->children, children, child) {
-		if (RTB_POINT_IN_RECT(cursor, *iter)
-				&& iter->visibility != RTB_FULLY_OBSCURED) {
-			ret = iter;
-			ret->mouse_in = 1;
+	slot = ret->geometry_slot;
 
-			dispatch_simple_mouse_event(win, ret, RTB_MOUSE_ENTER, -1, cursor);
+	while ((slot = rtb_geometry_store_child_at(geom, slot, cursor))) {
+		ret = geom->element[slot];
+		ret->mouse_in = 1;
 
-			if (win->mouse.buttons_down)
-				dispatch_drag_enter(win, ret, cursor);
+		dispatch_simple_mouse_event(win, ret, RTB_MOUSE_ENTER, -1, cursor);
 
-			goto descend;
-		}
+		if (win->mouse.buttons_down)
+			dispatch_drag_enter(win, ret, cursor);
+
+		/* a handler took it out of the tree */
+		if (ret->geometry_slot != slot)
+			break;
 	}
 
 	win->mouse.element_underneath = ret;
@@ -356,8 +361,8 @@ rtb__platform_mouse_release(struct rtb_window *win,
 	dispatch_simple_mouse_event(win, target, RTB_MOUSE_UP, button, pt);
 }
 
-void
-rtb__platform_mouse_motion(struct rtb_window *win, struct rtb_point pt)
+static void
+mouse_motion(struct rtb_window *win, struct rtb_point pt)
 {
 	struct rtb_size delta;
 
@@ -386,6 +391,31 @@ rtb__platform_mouse_motion(struct rtb_window *win, struct rtb_point pt)
 		win->mouse.previous = *RTB_UPCAST(&win->mouse, rtb_point);
 }
 
+void
+rtb__platform_mouse_motion_sample(struct rtb_window *win, struct rtb_point pt)
+{
+	struct rtb_mouse *mouse = &win->mouse;
+
+	if (mouse->history.count == RTB_MOUSE_MOTION_HISTORY) {
+		memmove(mouse->history.points, mouse->history.points + 1,
+				(RTB_MOUSE_MOTION_HISTORY - 1) * sizeof(pt));
+		mouse->history.count--;
+	}
+
+	mouse->history.points[mouse->history.count++] = pt;
+}
+
+void
+rtb__platform_mouse_motion(struct rtb_window *win, struct rtb_point pt)
+{
+	/* platforms that don't coalesce hand us one position at a time. */
+	if (!win->mouse.history.count)
+		rtb__platform_mouse_motion_sample(win, pt);
+
+	mouse_motion(win, pt);
+	win->mouse.history.count = 0;
+}
+
 void
 rtb__platform_mouse_wheel(struct rtb_window *win, struct rtb_point pt,
 		float delta)
@@ -461,3 +491,11 @@ rtb_mouse_unset_cursor(struct rtb_window *win, struct rtb_mouse *mouse)
 {
 	rtb_mouse_set_cursor(win, mouse, RTB_MOUSE_CURSOR_DEFAULT);
 }
+
+unsigned int
+rtb_mouse_motion_history(struct rtb_window *win,
+		const struct rtb_point **points)
+{
+	*points = win->mouse.history.points;
+	return win->mouse.history.count;
+}
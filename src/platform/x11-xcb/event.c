@@ -167,6 +167,16 @@ handle_mouse_button_release(struct xrtb_window *win,
 				RTB_MAKE_PHY_POINT(ev->event_x, ev->event_y)));
 }
 
+static void
+sample_mouse_motion(struct xrtb_window *win, const xcb_generic_event_t *_ev)
+{
+	CAST_EVENT_TO(xcb_motion_notify_event_t);
+	struct rtb_window *rwin = RTB_WINDOW(win);
+
+	rtb__platform_mouse_motion_sample(rwin, rtb_phy_to_point(rwin,
+			RTB_MAKE_PHY_POINT(ev->event_x, ev->event_y)));
+}
+
 static void
 handle_mouse_motion(struct xrtb_window *win, const xcb_generic_event_t *_ev)
 {
@@ -242,18 +252,19 @@ static void
 handle_visibility_notify(struct xrtb_window *win, xcb_generic_event_t *_ev)
 {
 	CAST_EVENT_TO(xcb_visibility_notify_event_t);
+	struct rtb_element *elem = RTB_ELEMENT(RTB_WINDOW(win));
 
 	switch (ev->state) {
 	case XCB_VISIBILITY_UNOBSCURED:
-		win->visibility = RTB_UNOBSCURED;
+		rtb_elem_set_visibility(elem, RTB_UNOBSCURED);
 		break;
 
 	case XCB_VISIBILITY_PARTIALLY_OBSCURED:
-		win->visibility = RTB_PARTIALLY_OBSCURED;
+		rtb_elem_set_visibility(elem, RTB_PARTIALLY_OBSCURED);
 		break;
 
 	case XCB_VISIBILITY_FULLY_OBSCURED:
-		win->visibility = RTB_FULLY_OBSCURED;
+		rtb_elem_set_visibility(elem, RTB_FULLY_OBSCURED);
 		break;
 	}
 }
@@ -547,21 +558,52 @@ handle_generic_event(struct xrtb_window *win, xcb_generic_event_t *ev)
 static int
 drain_xcb_event_queue(xcb_connection_t *conn, struct rtb_window *win)
 {
-	xcb_generic_event_t *ev;
+	struct xrtb_window *xwin = RTB_WINDOW_AS(win, xrtb_window);
+	xcb_generic_event_t *ev, *motion = NULL;
 	int ret, nevents;
 
 	nevents = 0;
 
 	while ((ev = xcb_poll_for_event(conn))) {
-		ret = handle_generic_event(RTB_WINDOW_AS(win, xrtb_window), ev);
 		nevents++;
 
+		/* a run of motion events is only handled once, at the last
+		 * position in the run. the drag delta is worked out from the
+		 * previous position, so none of the movement gets lost. */
+		if ((ev->response_type & ~0x80) == XCB_MOTION_NOTIFY) {
+			sample_mouse_motion(xwin, ev);
+
+			free(motion);
+			motion = ev;
+			continue;
+		}
+
+		if (motion) {
+			ret = handle_generic_event(xwin, motion);
+			free(motion);
+			motion = NULL;
+
+			if (ret) {
+				free(ev);
+				return -1;
+			}
+		}
+
+		ret = handle_generic_event(xwin, ev);
 		free(ev);
 
 		if (ret)
 			return -1;
 	}
 
+	if (motion) {
+		ret = handle_generic_event(xwin, motion);
+		free(motion);
+
+		if (ret)
+			return -1;
+	}
+
 	if (win->need_reconfigure) {
 		rtb_window_reinit(win);
 		win->need_reconfigure = 0;
@@ -44,7 +44,7 @@ rtb_render_use_style_fg(struct rtb_render_context *ctx,
 {
 	const struct rtb_style_property_definition *prop;
 	prop = rtb_style_query_prop(from,
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	rtb_render_set_color(ctx,
 			prop->color.r,
@@ -59,7 +59,7 @@ rtb_render_use_style_bg(struct rtb_render_context *ctx,
 {
 	const struct rtb_style_property_definition *prop;
 	prop = rtb_style_query_prop(from,
-			"color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	rtb_render_set_color(ctx,
 			prop->color.r,
@@ -188,18 +188,20 @@ rtb_render_reset(struct rtb_element *elem, const struct rtb_shader *shader)
 {
 	struct rtb_render_context *ctx = rtb_render_get_context(elem);
 	struct rtb_point scale = elem->window->scale;
+	const struct rtb_rect *clip = &elem->clip_rect;
 
 	if (!shader)
 		shader = &elem->window->local_storage.shader.dfault;
 
 	rtb_render_use_shader(ctx, shader);
 
+	/* scissor to the clip rect so nothing spills out past an ancestor */
 	glScissor(
-			scale.x * (elem->x - elem->surface->x),
+			scale.x * (clip->x - elem->surface->x),
 			(elem->surface->y + elem->surface->phy_size.h)
-			            - (scale.y * (elem->h + elem->y)),
-			scale.x * elem->w,
-			scale.y * elem->h);
+			            - (scale.y * (clip->h + clip->y)),
+			scale.x * clip->w,
+			scale.y * clip->h);
 
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
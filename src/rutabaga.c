@@ -30,9 +30,9 @@
 
 #include <rutabaga/rutabaga.h>
 #include <rutabaga/window.h>
-#include <rutabaga/dict.h>
 
 #include "rtb_private/stdlib-allocator.h"
+#include "rtb_private/slab.h"
 #include "rtb_private/window_impl.h"
 
 struct wwrl_allocator stdlib_allocator = {
@@ -52,9 +52,7 @@ rtb_new(void)
 
 	self->owns_application_event_loop = 1;
 
-	RTB_DICT_INIT(&self->atoms.type);
-
-	memcpy(&self->allocator, &stdlib_allocator,
+	memcpy(&self->allocator, &slab_allocator,
 			sizeof(self->allocator));
 
 	uv_loop_init(&self->event_loop);
@@ -0,0 +1,250 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <uv.h>
+
+#include "rtb_private/slab.h"
+
+/* classes go 32, 64, 128 ... 8192 bytes, header included. */
+#define SLAB_MIN_SHIFT 5
+#define SLAB_CLASSES   9
+#define SLAB_HUGE      SLAB_CLASSES
+
+#define SLAB_BLOCK_SIZE (64 * 1024)
+
+/* kept at 16 bytes so that what follows it is as aligned as malloc()'s
+ * memory would have been. */
+union slab_header {
+	unsigned int size_class;
+	unsigned char pad[16];
+};
+
+struct slab_free_chunk {
+	struct slab_free_chunk *next;
+};
+
+/* the free lists are shared by every rutabaga instance (constructors
+ * allocate without one), and those can live on different threads. */
+static struct slab_free_chunk *free_lists[SLAB_CLASSES];
+static uv_once_t free_lists_once = UV_ONCE_INIT;
+static uv_mutex_t free_lists_lock;
+
+/**
+ * internal
+ */
+
+static void
+init_lock(void)
+{
+	if (uv_mutex_init(&free_lists_lock))
+		abort();
+}
+
+static void
+lock_free_lists(void)
+{
+	uv_once(&free_lists_once, init_lock);
+	uv_mutex_lock(&free_lists_lock);
+}
+
+static void
+unlock_free_lists(void)
+{
+	uv_mutex_unlock(&free_lists_lock);
+}
+
+static size_t
+class_size(unsigned int size_class)
+{
+	return (size_t) 1 << (size_class + SLAB_MIN_SHIFT);
+}
+
+static unsigned int
+class_for(size_t size)
+{
+	unsigned int size_class;
+
+	size += sizeof(union slab_header);
+
+	for (size_class = 0; size_class < SLAB_CLASSES; size_class++)
+		if (size <= class_size(size_class))
+			return size_class;
+
+	return SLAB_HUGE;
+}
+
+static union slab_header *
+header_of(void *ptr)
+{
+	return ((union slab_header *) ptr) - 1;
+}
+
+static size_t
+usable_size(void *ptr)
+{
+	union slab_header *hdr = header_of(ptr);
+
+	assert(hdr->size_class < SLAB_HUGE);
+	return class_size(hdr->size_class) - sizeof(*hdr);
+}
+
+/* called with the free lists locked */
+static int
+refill(unsigned int size_class)
+{
+	struct slab_free_chunk *chunk;
+	size_t size = class_size(size_class);
+	char *block, *iter;
+
+	if (!(block = malloc(SLAB_BLOCK_SIZE)))
+		return -1;
+
+	for (iter = block; iter + size <= block + SLAB_BLOCK_SIZE; iter += size) {
+		chunk = (struct slab_free_chunk *) iter;
+		chunk->next = free_lists[size_class];
+		free_lists[size_class] = chunk;
+	}
+
+	return 0;
+}
+
+/**
+ * allocator
+ */
+
+static void *
+slab_malloc(size_t size)
+{
+	union slab_header *hdr;
+	unsigned int size_class = class_for(size);
+
+	if (size_class == SLAB_HUGE) {
+		if (!(hdr = malloc(sizeof(*hdr) + size)))
+			return NULL;
+	} else {
+		lock_free_lists();
+
+		if (!free_lists[size_class] && refill(size_class)) {
+			unlock_free_lists();
+			return NULL;
+		}
+
+		hdr = (union slab_header *) free_lists[size_class];
+		free_lists[size_class] = free_lists[size_class]->next;
+
+		unlock_free_lists();
+	}
+
+	hdr->size_class = size_class;
+	return hdr + 1;
+}
+
+static void
+slab_free(void *ptr)
+{
+	struct slab_free_chunk *chunk;
+	union slab_header *hdr;
+	unsigned int size_class;
+
+	if (!ptr)
+		return;
+
+	hdr = header_of(ptr);
+	size_class = hdr->size_class;
+
+	if (size_class == SLAB_HUGE) {
+		free(hdr);
+		return;
+	}
+
+	/* the free list link goes where the header was. */
+	chunk = (struct slab_free_chunk *) hdr;
+
+	lock_free_lists();
+	chunk->next = free_lists[size_class];
+	free_lists[size_class] = chunk;
+	unlock_free_lists();
+}
+
+static void *
+slab_calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	if (size && nmemb > (size_t) -1 / size)
+		return NULL;
+
+	if ((ptr = slab_malloc(nmemb * size)))
+		memset(ptr, 0, nmemb * size);
+
+	return ptr;
+}
+
+static void *
+slab_realloc(void *ptr, size_t size)
+{
+	union slab_header *hdr;
+	void *new_ptr;
+	size_t old_size;
+
+	if (!ptr)
+		return slab_malloc(size);
+
+	hdr = header_of(ptr);
+
+	if (hdr->size_class == SLAB_HUGE) {
+		if (class_for(size) != SLAB_HUGE)
+			goto move;
+
+		if (!(hdr = realloc(hdr, sizeof(*hdr) + size)))
+			return NULL;
+
+		return hdr + 1;
+	}
+
+	if (size <= usable_size(ptr))
+		return ptr;
+
+move:
+	if (!(new_ptr = slab_malloc(size)))
+		return NULL;
+
+	old_size = (hdr->size_class == SLAB_HUGE) ? size : usable_size(ptr);
+	memcpy(new_ptr, ptr, (old_size < size) ? old_size : size);
+
+	slab_free(ptr);
+	return new_ptr;
+}
+
+struct wwrl_allocator slab_allocator = {
+	.malloc  = slab_malloc,
+	.free    = slab_free,
+	.calloc  = slab_calloc,
+	.realloc = slab_realloc
+};
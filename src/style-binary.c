@@ -0,0 +1,573 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013-2018 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <rutabaga/rutabaga.h>
+#include <rutabaga/asset.h>
+#include <rutabaga/style.h>
+#include <rutabaga/style-binary.h>
+
+#include "rtb_private/util.h"
+
+/**
+ * bounds checking
+ */
+
+static int
+in_bounds(struct rtb_style_binary *bin, uint32_t off, size_t len)
+{
+	return off && off <= bin->size && len <= bin->size - off;
+}
+
+#define ALIGNOF(type) offsetof(struct { char c; type t; }, t)
+
+static int
+is_aligned(const void *p, size_t align)
+{
+	return !((uintptr_t) p % align);
+}
+
+/* only for offsets that have already been through record() */
+#define AT(bin, off, type) ((const type *) ((bin)->base + (off)))
+
+#define RECORD(bin, off, type, n) \
+	record(bin, off, sizeof(type), ALIGNOF(type), n)
+
+static const void *
+record(struct rtb_style_binary *bin, uint32_t off, size_t size, size_t align,
+		size_t n)
+{
+	if (n && (size_t) -1 / n < size)
+		return NULL;
+
+	if (!in_bounds(bin, off, size * n) || !is_aligned(bin->base + off, align))
+		return NULL;
+
+	return bin->base + off;
+}
+
+static const char *
+string(struct rtb_style_binary *bin, uint32_t off)
+{
+	if (!off)
+		return NULL;
+
+	if (!in_bounds(bin, off, 1)
+			|| !memchr(bin->base + off, '\0', bin->size - off))
+		return NULL;
+
+	return (const char *) (bin->base + off);
+}
+
+/**
+ * the allocation block
+ */
+
+struct counts {
+	size_t styles;
+	size_t properties;
+	size_t faces;
+	size_t selectors;
+	size_t compounds;
+	size_t names;
+};
+
+struct block {
+	struct rtb_style *styles;
+	struct rtb_style_property_definition *properties;
+	struct rtb_style_font_face *faces;
+	struct rtb_style_selector *selectors;
+	struct rtb_style_compound *compounds;
+	struct rtb_style_name *names;
+	const char **prop_names;
+};
+
+#define BLOCK_ALIGN(x) (((x) + 15) & ~((size_t) 15))
+
+static void *
+carve(char **cursor, size_t n, size_t size)
+{
+	void *ret = *cursor;
+	*cursor += BLOCK_ALIGN(n * size);
+	return ret;
+}
+
+static int
+count(struct rtb_style_binary *bin, const struct rtb_style_binary_style *styles,
+		size_t nstyles, struct counts *c)
+{
+	const struct rtb_style_binary_property *props;
+	const struct rtb_style_binary_selector *sel;
+	size_t i, j, state;
+
+	memset(c, 0, sizeof(*c));
+	c->styles = nstyles + 1;
+
+	for (i = 0; i < nstyles; i++) {
+		for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+			c->properties += styles[i].nproperties[state] + 1;
+
+			if (!styles[i].nproperties[state])
+				continue;
+
+			props = RECORD(bin, styles[i].properties[state],
+					struct rtb_style_binary_property,
+					styles[i].nproperties[state]);
+			if (!props)
+				return -1;
+
+			for (j = 0; j < styles[i].nproperties[state]; j++)
+				if (props[j].type == RTB_STYLE_PROP_FONT)
+					c->faces++;
+		}
+
+		if (!styles[i].selector)
+			continue;
+
+		if (!(sel = RECORD(bin, styles[i].selector,
+						struct rtb_style_binary_selector, 1))
+				|| !RECORD(bin, styles[i].selector + sizeof(*sel),
+					struct rtb_style_binary_compound, sel->ncompounds)
+				|| !sel->ncompounds)
+			return -1;
+
+		c->selectors++;
+		c->compounds += sel->ncompounds;
+
+		for (j = 0; j < sel->ncompounds; j++)
+			if (sel->compounds[j].nclasses)
+				c->names += sel->compounds[j].nclasses + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * filling in
+ */
+
+static int
+fill_asset(struct rtb_style_binary *bin, struct rtb_asset *asset,
+		const struct rtb_style_binary_asset *rec)
+{
+	asset->compression = RTB_ASSET_UNCOMPRESSED;
+
+	switch (rec->location) {
+	case RTB_ASSET_EMBEDDED:
+		if (!record(bin, rec->data, 1, 1, rec->size))
+			return -1;
+
+		asset->location = RTB_ASSET_EMBEDDED;
+		asset->buffer.allocated = 0;
+		asset->buffer.data = bin->base + rec->data;
+		asset->buffer.size = rec->size;
+		asset->loaded = 1;
+		return 0;
+
+	case RTB_ASSET_EXTERNAL:
+		if (!(asset->external.path = (char *) string(bin, rec->data)))
+			return -1;
+
+		asset->location = RTB_ASSET_EXTERNAL;
+
+		/* not fatal. style.c reports unloaded assets when it gets to
+		 * them, same as with compiled-in stylesheets. */
+		if (rtb_asset_load(asset))
+			printf("rutabaga: couldn't load \"%s\"\n", asset->external.path);
+		return 0;
+	}
+
+	return -1;
+}
+
+static int
+fill_property(struct rtb_style_binary *bin, struct block *b,
+		struct rtb_style_property_definition *def,
+		const struct rtb_style_binary_property *rec)
+{
+	const struct rtb_style_binary_font_face *face_rec;
+	const struct rtb_style_binary_asset *asset_rec;
+	struct rtb_style_font_face *face;
+
+	if (!(def->property_name = string(bin, rec->name)))
+		return -1;
+
+	def->id = rec->id;
+	def->type = rec->type;
+
+	switch (rec->type) {
+	case RTB_STYLE_PROP_COLOR:
+		def->color.r = rec->color[0];
+		def->color.g = rec->color[1];
+		def->color.b = rec->color[2];
+		def->color.a = rec->color[3];
+		break;
+
+	case RTB_STYLE_PROP_FLOAT:
+		def->flt = rec->flt;
+		break;
+
+	case RTB_STYLE_PROP_INT:
+		def->i = rec->i;
+		break;
+
+	case RTB_STYLE_PROP_TEXTURE:
+		asset_rec = RECORD(bin, rec->texture.asset,
+				struct rtb_style_binary_asset, 1);
+		if (!asset_rec || fill_asset(bin, RTB_ASSET(&def->texture), asset_rec))
+			return -1;
+
+		def->texture.w = rec->texture.w;
+		def->texture.h = rec->texture.h;
+		def->texture.flags = rec->texture.flags;
+
+		def->texture.border.top    = rec->texture.border[0];
+		def->texture.border.right  = rec->texture.border[1];
+		def->texture.border.bottom = rec->texture.border[2];
+		def->texture.border.left   = rec->texture.border[3];
+		break;
+
+	case RTB_STYLE_PROP_FONT:
+		face_rec = RECORD(bin, rec->font.face,
+				struct rtb_style_binary_font_face, 1);
+
+		/* the slot indexes the window's font table, which is sized
+		 * from the header's font count. */
+		if (!face_rec || rec->font.slot >= bin->data.nfonts)
+			return -1;
+
+		face = b->faces++;
+		face->family = string(bin, face_rec->family);
+		face->weight = string(bin, face_rec->weight);
+
+		if (fill_asset(bin, RTB_ASSET(face), &face_rec->asset))
+			return -1;
+
+		def->font.face = face;
+		def->font.size = rec->font.size;
+		def->font.lcd_gamma = rec->font.lcd_gamma;
+		def->font.slot = rec->font.slot;
+		break;
+
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+fill_name(struct rtb_style_binary *bin, struct rtb_style_name *name,
+		const struct rtb_style_binary_name *rec)
+{
+	name->hash = rec->hash;
+
+	if (!rec->name) {
+		name->name = NULL;
+		return 0;
+	}
+
+	return (name->name = string(bin, rec->name)) ? 0 : -1;
+}
+
+static int
+fill_selector(struct rtb_style_binary *bin, struct block *b,
+		struct rtb_style *style, uint32_t off)
+{
+	const struct rtb_style_binary_selector *rec;
+	const struct rtb_style_binary_compound *crec;
+	const struct rtb_style_binary_name *classes;
+	struct rtb_style_selector *sel;
+	struct rtb_style_compound *compound;
+	uint32_t i, j;
+
+	rec = AT(bin, off, struct rtb_style_binary_selector);
+
+	sel = b->selectors++;
+	sel->specificity = rec->specificity;
+	sel->ncompounds = rec->ncompounds;
+	sel->compounds = compound = b->compounds;
+	b->compounds += rec->ncompounds;
+
+	for (i = 0; i < rec->ncompounds; i++, compound++) {
+		crec = &rec->compounds[i];
+
+		if (fill_name(bin, &compound->type, &crec->type)
+				|| fill_name(bin, &compound->id, &crec->id))
+			return -1;
+
+		if (!crec->nclasses) {
+			compound->classes = NULL;
+			continue;
+		}
+
+		classes = RECORD(bin, crec->classes,
+				struct rtb_style_binary_name, crec->nclasses);
+		if (!classes)
+			return -1;
+
+		compound->classes = b->names;
+
+		for (j = 0; j < crec->nclasses; j++)
+			if (fill_name(bin, b->names++, &classes[j]))
+				return -1;
+
+		(b->names++)->name = NULL;
+	}
+
+	style->selector = sel;
+	return 0;
+}
+
+static int
+fill_style(struct rtb_style_binary *bin, struct block *b,
+		struct rtb_style *style, const struct rtb_style_binary_style *rec)
+{
+	const struct rtb_style_binary_property *props;
+	rtb_draw_state_t state;
+	uint32_t i;
+
+	if (!(style->for_type = string(bin, rec->for_type)))
+		return -1;
+
+	if (rec->selector && fill_selector(bin, b, style, rec->selector))
+		return -1;
+
+	for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+		style->properties[state] = b->properties;
+
+		/* already bounds-checked by count() */
+		props = AT(bin, rec->properties[state],
+				struct rtb_style_binary_property);
+
+		for (i = 0; i < rec->nproperties[state]; i++)
+			if (fill_property(bin, b, b->properties++, &props[i]))
+				return -1;
+
+		/* terminator, left zeroed by calloc */
+		b->properties++;
+	}
+
+	return 0;
+}
+
+/**
+ * public API
+ */
+
+int
+rtb_style_binary_load_buffer(struct rtb_style_binary *bin,
+		const void *buffer, size_t size)
+{
+	const struct rtb_style_binary_header *hdr;
+	const struct rtb_style_binary_style *styles;
+	const uint32_t *prop_names;
+	struct counts c;
+	struct block b;
+	size_t need, i;
+	char *cursor;
+
+	memset(bin, 0, sizeof(*bin));
+	bin->base = buffer;
+	bin->size = size;
+
+	hdr = buffer;
+
+	if (size < sizeof(*hdr)
+			|| !is_aligned(hdr, ALIGNOF(struct rtb_style_binary_header))
+			|| memcmp(hdr->magic, RTB_STYLE_BINARY_MAGIC, sizeof(hdr->magic))
+			|| hdr->version != RTB_STYLE_BINARY_VERSION
+			|| hdr->size > size)
+		goto err_format;
+
+	bin->size = hdr->size;
+
+	styles = RECORD(bin, hdr->styles,
+			struct rtb_style_binary_style, hdr->nstyles);
+	prop_names = RECORD(bin, hdr->prop_names, uint32_t, hdr->nprops);
+
+	if ((hdr->nstyles && !styles) || (hdr->nprops && !prop_names)
+			|| count(bin, styles, hdr->nstyles, &c))
+		goto err_format;
+
+	need = BLOCK_ALIGN(c.styles * sizeof(*b.styles))
+		+ BLOCK_ALIGN(c.properties * sizeof(*b.properties))
+		+ BLOCK_ALIGN(c.faces * sizeof(*b.faces))
+		+ BLOCK_ALIGN(c.selectors * sizeof(*b.selectors))
+		+ BLOCK_ALIGN(c.compounds * sizeof(*b.compounds))
+		+ BLOCK_ALIGN(c.names * sizeof(*b.names))
+		+ BLOCK_ALIGN((hdr->nprops + 1) * sizeof(*b.prop_names));
+
+	if (!(bin->block = cursor = calloc(1, need)))
+		goto err_alloc;
+
+	b.styles     = carve(&cursor, c.styles, sizeof(*b.styles));
+	b.properties = carve(&cursor, c.properties, sizeof(*b.properties));
+	b.faces      = carve(&cursor, c.faces, sizeof(*b.faces));
+	b.selectors  = carve(&cursor, c.selectors, sizeof(*b.selectors));
+	b.compounds  = carve(&cursor, c.compounds, sizeof(*b.compounds));
+	b.names      = carve(&cursor, c.names, sizeof(*b.names));
+	b.prop_names = carve(&cursor, hdr->nprops + 1, sizeof(*b.prop_names));
+
+	bin->data.style      = b.styles;
+	bin->data.nfonts     = hdr->nfonts;
+	bin->data.prop_names = b.prop_names;
+	bin->data.nprops     = hdr->nprops;
+
+	for (i = 0; i < hdr->nprops; i++)
+		if (!(b.prop_names[i] = string(bin, prop_names[i])))
+			goto err_fill;
+
+	for (i = 0; i < hdr->nstyles; i++)
+		if (fill_style(bin, &b, &b.styles[i], &styles[i]))
+			goto err_fill;
+
+	return 0;
+
+err_fill:
+	free(bin->block);
+err_alloc:
+err_format:
+	memset(bin, 0, sizeof(*bin));
+	return -1;
+}
+
+#ifndef _WIN32
+
+int
+rtb_style_binary_load(struct rtb_style_binary *bin, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		goto err_open;
+
+	if (fstat(fd, &st) || !st.st_size)
+		goto err_stat;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto err_stat;
+
+	close(fd);
+
+	if (rtb_style_binary_load_buffer(bin, map, st.st_size)) {
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	bin->mapped = st.st_size;
+	return 0;
+
+err_stat:
+	close(fd);
+err_open:
+	return -1;
+}
+
+#else
+
+int
+rtb_style_binary_load(struct rtb_style_binary *bin, const char *path)
+{
+	struct rtb_asset file = {
+		.location = RTB_ASSET_EXTERNAL,
+		.external.path = (char *) path
+	};
+
+	/* no mmap here, so read the whole thing in. the buffer is owned by
+	 * the stylesheet from here on. */
+	if (rtb_asset_load(&file))
+		return -1;
+
+	if (rtb_style_binary_load_buffer(bin,
+				file.buffer.data, file.buffer.size)) {
+		rtb_asset_free(&file);
+		return -1;
+	}
+
+	bin->mapped = file.buffer.size;
+	return 0;
+}
+
+#endif
+
+void
+rtb_style_binary_unload(struct rtb_style_binary *bin)
+{
+	struct rtb_style_property_definition *prop;
+	struct rtb_style *s;
+	rtb_draw_state_t state;
+
+	if (!bin->block)
+		return;
+
+	/* external assets were read into buffers of their own */
+	for (s = bin->data.style; s->for_type; s++) {
+		for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+			prop = (struct rtb_style_property_definition *)
+				s->properties[state];
+
+			for (; prop->property_name; prop++) {
+				if (prop->type == RTB_STYLE_PROP_TEXTURE
+						&& prop->texture.location == RTB_ASSET_EXTERNAL
+						&& prop->texture.loaded)
+					rtb_asset_free(RTB_ASSET(&prop->texture));
+				else if (prop->type == RTB_STYLE_PROP_FONT
+						&& prop->font.face->location == RTB_ASSET_EXTERNAL
+						&& prop->font.face->loaded)
+					rtb_asset_free(RTB_ASSET(
+						(struct rtb_style_font_face *) prop->font.face));
+			}
+		}
+	}
+
+	free(bin->block);
+
+	if (bin->mapped) {
+#ifndef _WIN32
+		munmap((void *) bin->base, bin->mapped);
+#else
+		free((void *) bin->base);
+#endif
+	}
+
+	memset(bin, 0, sizeof(*bin));
+}
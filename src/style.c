@@ -31,6 +31,7 @@
 #include <rutabaga/asset.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/stdlib-allocator.h"
 
 /* generated as part of the build process */
 #include "styles/default/style.h"
@@ -113,6 +114,11 @@ load_assets(struct rtb_window *window,
 				return -1;
 
 			font = rtb_style_get_font_for_def(window, &property->font);
+
+			/* several styles can share a font slot */
+			if (font->fm)
+				break;
+
 			font->lcd_gamma = property->font.lcd_gamma;
 
 			if (rtb_font_manager_load_embedded_font(&window->font_manager,
@@ -132,109 +138,847 @@ load_assets(struct rtb_window *window,
 	return assets_loaded;
 }
 
-static struct rtb_style *
-style_for_type(struct rtb_type_atom *atom, struct rtb_style *s)
+/**
+ * themes
+ */
+
+struct rtb_style_theme {
+	struct rtb_style_data data;
+
+	/* the theme's style corresponding to each style in the window's
+	 * list (same type and selector), or NULL. */
+	struct rtb_style **counterparts;
+	size_t ncounterparts;
+
+	/* theme property id -> window property id, or -1 if the window's
+	 * stylesheet doesn't know the property. */
+	int *prop_map;
+
+	/* the theme's fonts get their own slots, so they're told apart from
+	 * the window's by definition pointer. */
+	struct rtb_font *fonts;
+	const struct rtb_style_font_definition **font_defs;
+	size_t nfont_defs;
+};
+
+static struct rtb_style_theme *
+get_theme(struct rtb_window *window, int theme)
 {
-	for (; s->for_type; s++) {
-		if (s->resolved_type && rtb_is_type(s->resolved_type, atom)) {
-			return s;
-		}
+	if (theme <= 0 || theme > window->style_nthemes)
+		return NULL;
+
+	return &window->style_themes[theme - 1];
+}
+
+static const struct rtb_style *
+theme_counterpart(struct rtb_window *window, struct rtb_style_theme *theme,
+		const struct rtb_style *style)
+{
+	if (!theme || style < window->style_list
+			|| style >= window->style_list + theme->ncounterparts)
+		return NULL;
+
+	return theme->counterparts[style - window->style_list];
+}
+
+static int
+theme_prop_id(struct rtb_style_theme *theme, rtb_style_prop_id_t prop_id)
+{
+	if (prop_id < 0 || (size_t) prop_id >= theme->data.nprops)
+		return -1;
+
+	return theme->prop_map[prop_id];
+}
+
+/**
+ * comparing definitions
+ */
+
+static int
+strings_equal(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return !strcmp(a, b);
+}
+
+static int
+assets_equal(const struct rtb_asset *a, const struct rtb_asset *b)
+{
+	if (a->location != b->location)
+		return 0;
+
+	if (a->location == RTB_ASSET_EXTERNAL)
+		return strings_equal(a->external.path, b->external.path);
+
+	return a->buffer.data == b->buffer.data
+		&& a->buffer.size == b->buffer.size;
+}
+
+static int
+fonts_equal(const struct rtb_style_font_definition *a,
+		const struct rtb_style_font_definition *b)
+{
+	if (a->size != b->size || a->lcd_gamma != b->lcd_gamma)
+		return 0;
+
+	if (a->face == b->face)
+		return 1;
+
+	if (!a->face || !b->face)
+		return 0;
+
+	return strings_equal(a->face->family, b->face->family)
+		&& strings_equal(a->face->weight, b->face->weight)
+		&& assets_equal(RTB_ASSET(a->face), RTB_ASSET(b->face));
+}
+
+static int
+textures_equal(const struct rtb_style_texture_definition *a,
+		const struct rtb_style_texture_definition *b)
+{
+	return a->flags == b->flags
+		&& a->w == b->w && a->h == b->h
+		&& a->border.top == b->border.top
+		&& a->border.right == b->border.right
+		&& a->border.bottom == b->border.bottom
+		&& a->border.left == b->border.left
+		&& assets_equal(RTB_ASSET(a), RTB_ASSET(b));
+}
+
+int
+rtb_style_props_equal(const struct rtb_style_property_definition *a,
+		const struct rtb_style_property_definition *b)
+{
+	if (a == b)
+		return 1;
+
+	if (!a || !b || a->type != b->type)
+		return 0;
+
+	switch (a->type) {
+	case RTB_STYLE_PROP_COLOR:
+		return a->color.r == b->color.r && a->color.g == b->color.g
+			&& a->color.b == b->color.b && a->color.a == b->color.a;
+
+	case RTB_STYLE_PROP_FLOAT:
+		return a->flt == b->flt;
+
+	case RTB_STYLE_PROP_INT:
+		return a->i == b->i;
+
+	case RTB_STYLE_PROP_FONT:
+		return fonts_equal(&a->font, &b->font);
+
+	case RTB_STYLE_PROP_TEXTURE:
+		return textures_equal(&a->texture, &b->texture);
+
+	default:
+		return 0;
 	}
+}
 
-	return NULL;
+static int
+tables_equal(const struct rtb_style_property_definition **a,
+		const struct rtb_style_property_definition **b, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (!rtb_style_props_equal(a[i], b[i]))
+			return 0;
+
+	return 1;
 }
 
-static struct rtb_style *
-inherits_from(struct rtb_type_atom_descriptor *type,
-		struct rtb_style *style_list)
+/**
+ * lookup tables
+ */
+
+/* the order in which draw states are searched for each element state.
+ * RTB_DRAW_STATE_COUNT terminates. */
+static const rtb_draw_state_t state_fallbacks[RTB_STYLE_STATE_COUNT][4] = {
+	[RTB_STATE_UNATTACHED] =
+		{RTB_DRAW_NORMAL, RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_NORMAL] =
+		{RTB_DRAW_NORMAL, RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_HOVER] =
+		{RTB_DRAW_HOVER, RTB_DRAW_NORMAL, RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_ACTIVE] =
+		{RTB_DRAW_ACTIVE, RTB_DRAW_NORMAL, RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_FOCUS] =
+		{RTB_DRAW_FOCUS, RTB_DRAW_NORMAL, RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_FOCUS_HOVER] =
+		{RTB_DRAW_HOVER, RTB_DRAW_FOCUS, RTB_DRAW_NORMAL,
+			RTB_DRAW_STATE_COUNT},
+	[RTB_STATE_FOCUS_ACTIVE] =
+		{RTB_DRAW_ACTIVE, RTB_DRAW_FOCUS, RTB_DRAW_NORMAL,
+			RTB_DRAW_STATE_COUNT}
+};
+
+static void
+free_lookup(struct rtb_style *style)
+{
+	int i;
+
+	for (i = 0; i < style->ntheme_lookups; i++)
+		free(style->theme_lookup[i][0]);
+
+	free(style->theme_lookup);
+	style->theme_lookup = NULL;
+	style->ntheme_lookups = 0;
+
+	memset(style->lookup, 0, sizeof(style->lookup));
+}
+
+/* flattens the style's own properties, its ancestors' properties, and the
+ * state fallbacks into one table per element state. the fill order
+ * (fallback state outermost, then inheritance, then declaration order)
+ * is the order the old string-matching query searched in, and the first
+ * match wins. under a theme, each style's counterpart in the theme is
+ * searched just before the style itself, so a theme only has to mention
+ * what it changes. */
+static int
+build_tables(struct rtb_window *window, struct rtb_style *style,
+		struct rtb_style_theme *theme,
+		const struct rtb_style_property_definition **tables[])
 {
-	struct rtb_type_atom_descriptor *super;
+	const struct rtb_style_property_definition **table, *prop;
+	const struct rtb_style *ancestor, *counterpart;
+	const rtb_draw_state_t *draw_state;
+	size_t nprops;
+	int state, id;
 
-	for (; style_list->for_type; style_list++) {
-		for (super = type->super[0]; super; super = super->super[0]) {
-			if (style_list->resolved_type == super)
-				return style_list;
+	nprops = window->style_nprops;
+
+	table = calloc(RTB_STYLE_STATE_COUNT * nprops, sizeof(*table));
+	if (!table)
+		return -1;
+
+	for (state = 0; state < RTB_STYLE_STATE_COUNT; state++, table += nprops) {
+		tables[state] = table;
+
+		for (draw_state = state_fallbacks[state];
+				*draw_state != RTB_DRAW_STATE_COUNT; draw_state++) {
+			for (ancestor = style; ancestor;
+					ancestor = ancestor->inherit_from) {
+				counterpart = theme_counterpart(window, theme, ancestor);
+
+				if (counterpart) {
+					prop = counterpart->properties[*draw_state];
+
+					for (; prop->property_name; prop++) {
+						id = theme_prop_id(theme, prop->id);
+
+						if (id >= 0 && (size_t) id < nprops && !table[id])
+							table[id] = prop;
+					}
+				}
+
+				prop = ancestor->properties[*draw_state];
+
+				for (; prop->property_name; prop++)
+					if ((size_t) prop->id < nprops && !table[prop->id])
+						table[prop->id] = prop;
+			}
 		}
 	}
 
-	return NULL;
+	return 0;
 }
 
+/* makes sure the style has tables for `theme`, building them if this is
+ * the first time the style has been needed under it. */
 static int
-style_resolve(struct rtb_window *window, struct rtb_style *style)
+theme_tables(struct rtb_window *window, struct rtb_style *style, int theme)
 {
-	rtb_draw_state_t state;
+	const struct rtb_style_property_definition **(*grown)[RTB_STYLE_STATE_COUNT];
+
+	if (theme >= style->ntheme_lookups) {
+		grown = realloc(style->theme_lookup,
+				(theme + 1) * sizeof(*style->theme_lookup));
+		if (!grown)
+			return -1;
+
+		memset(&grown[style->ntheme_lookups], 0,
+				(theme + 1 - style->ntheme_lookups) * sizeof(*grown));
 
-	style->resolved_type = rtb_type_lookup(window, style->for_type);
-	if (!style->resolved_type)
+		style->theme_lookup = grown;
+		style->ntheme_lookups = theme + 1;
+	}
+
+	if (style->theme_lookup[theme][0])
+		return 0;
+
+	return build_tables(window, style, get_theme(window, theme),
+			style->theme_lookup[theme]);
+}
+
+static int
+build_lookup(struct rtb_window *window, struct rtb_style *style)
+{
+	free_lookup(style);
+
+	if (theme_tables(window, style, 0)
+			|| theme_tables(window, style, window->style_theme))
 		return -1;
 
-	style->inherit_from = inherits_from(style->resolved_type, style);
+	memcpy(style->lookup, style->theme_lookup[window->style_theme],
+			sizeof(style->lookup));
+	return 0;
+}
+
+/**
+ * matching styles to types
+ */
+
+static struct rtb_style *style_for_descriptor(struct rtb_window *,
+		struct rtb_style *style_list, struct rtb_type_atom_descriptor *);
+
+static struct rtb_style *
+find_style_named(struct rtb_style *style_list, const char *type_name)
+{
+	for (; style_list->for_type; style_list++)
+		if (!style_list->selector
+				&& !strcmp(style_list->for_type, type_name))
+			return style_list;
+
+	return NULL;
+}
+
+static void
+style_load_assets(struct rtb_window *window, struct rtb_style *style)
+{
+	rtb_draw_state_t state;
 
 	for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
 		if (load_assets(window, style->properties[state]) < 0)
 			printf("rutabaga: error loading assets for %s\n",
 					style->for_type);
 	}
+}
+
+static int
+style_resolve(struct rtb_window *window, struct rtb_style *style_list,
+		struct rtb_style *style, struct rtb_type_atom_descriptor *type)
+{
+	style->resolved_type = type;
+
+	/* already resolved through another type that falls back to it */
+	if (style->lookup[0])
+		return 0;
+
+	style->inherit_from =
+		style_for_descriptor(window, style_list, RTB_TYPE_SUPER(type));
+
+	style_load_assets(window, style);
+	return build_lookup(window, style);
+}
+
+/* rules don't inherit from anything -- whatever they don't set falls
+ * through to the next matching rule, and finally to the type style. */
+static int
+rule_resolve(struct rtb_window *window, struct rtb_style *rule)
+{
+	if (rule->lookup[0])
+		return 0;
+
+	style_load_assets(window, rule);
+	return build_lookup(window, rule);
+}
+
+static int
+type_matches(struct rtb_type_atom_descriptor *type,
+		const struct rtb_style_name *name)
+{
+	unsigned int i;
+
+	if (!name->name)
+		return 1;
+
+	if (!type)
+		return 0;
+
+	for (i = 0; i <= type->depth; i++)
+		if (!strcmp(type->ancestors[i]->name, name->name))
+			return 1;
 
 	return 0;
 }
 
+/* the rules whose subject could match an element of `type`, in source
+ * order. NULL if there aren't any, which is the common case. */
+static struct rtb_style **
+rules_for_type(struct rtb_window *window, struct rtb_style *style_list,
+		struct rtb_type_atom_descriptor *type)
+{
+	struct rtb_style **rules, **grown, *s;
+	size_t count;
+
+	rules = NULL;
+	count = 0;
+
+	for (s = style_list; s->for_type; s++) {
+		if (!s->selector
+				|| !type_matches(type, &s->selector->compounds[0].type))
+			continue;
+
+		if (rule_resolve(window, s))
+			printf("rutabaga: couldn't resolve rule for %s\n", s->for_type);
+
+		if (!(grown = realloc(rules, (count + 2) * sizeof(*rules)))) {
+			free(rules);
+			return NULL;
+		}
+
+		rules = grown;
+		rules[count++] = s;
+		rules[count] = NULL;
+	}
+
+	return rules;
+}
+
+/* style_for_descriptor()'s answers, per window and indexed by type id.
+ * descriptors are shared by every window in the process, so the cache
+ * can't live on them. */
+struct rtb_style_type_cache {
+	struct rtb_style *style;
+
+	/* selector rules whose subject could match this type, NULL-terminated
+	 * (or NULL if there aren't any). */
+	struct rtb_style **rules;
+
+	/* only valid while this matches the window's style_generation */
+	unsigned int generation;
+};
+
+static struct rtb_style_type_cache *
+type_cache(struct rtb_window *window, struct rtb_type_atom_descriptor *type)
+{
+	struct rtb_style_type_cache *grown;
+	unsigned int size;
+
+	if (type->id < window->style_type_cache_size)
+		return &window->style_type_cache[type->id];
+
+	size = rtb_type_count();
+	grown = realloc(window->style_type_cache, size * sizeof(*grown));
+	if (!grown)
+		return NULL;
+
+	memset(&grown[window->style_type_cache_size], 0,
+			(size - window->style_type_cache_size) * sizeof(*grown));
+
+	window->style_type_cache = grown;
+	window->style_type_cache_size = size;
+
+	return &grown[type->id];
+}
+
+/* the most specific style for `type`: the one written for it, or failing
+ * that, its nearest supertype's. the answer is cached per window, so the
+ * style list is only searched once per type rather than once per
+ * element. styles are resolved lazily here too, which means widgets whose
+ * type first shows up after the window was attached still get styled. */
+static struct rtb_style *
+style_for_descriptor(struct rtb_window *window, struct rtb_style *style_list,
+		struct rtb_type_atom_descriptor *type)
+{
+	struct rtb_style_type_cache *cache;
+	struct rtb_style *style;
+
+	if (!type)
+		return NULL;
+
+	/* style_list is public, so someone may have swapped it out from
+	 * under the cache. */
+	if (window->style_cache_list != window->style_list) {
+		window->style_cache_list = window->style_list;
+		window->style_generation++;
+	}
+
+	cache = (style_list == window->style_list)
+		? type_cache(window, type) : NULL;
+
+	if (cache && cache->generation == window->style_generation)
+		return cache->style;
+
+	if ((style = find_style_named(style_list, type->name))) {
+		if (style_resolve(window, style_list, style, type))
+			printf("rutabaga: couldn't resolve style for %s\n",
+					style->for_type);
+	} else
+		style = style_for_descriptor(window, style_list,
+				RTB_TYPE_SUPER(type));
+
+	if (cache) {
+		free(cache->rules);
+		cache->rules = rules_for_type(window, style_list, type);
+
+		cache->style = style;
+		cache->generation = window->style_generation;
+	}
+
+	return style;
+}
+
 /**
- * queries
+ * selectors
  */
 
-static const struct rtb_style_property_definition *
-query_no_fallback(struct rtb_style *style_list, rtb_elem_state_t elem_state,
-		const char *property_name, rtb_style_prop_type_t type)
+#define PARENT_OF(elem) \
+	(((elem)->parent && (elem)->parent != (elem)) ? (elem)->parent : NULL)
+
+uint32_t
+rtb_style_hash(const char *name)
 {
-	const struct rtb_style_property_definition *prop;
-	rtb_draw_state_t draw_state;
+	uint32_t hash = 0x811C9DC5u;
+
+	for (; *name; name++) {
+		hash ^= (uint8_t) *name;
+		hash *= 0x01000193u;
+	}
+
+	return hash;
+}
+
+/* two bits per name, taken from different halves of the hash. */
+#define FILTER_BIT_A(hash) ((hash) & (RTB_STYLE_FILTER_BITS - 1))
+#define FILTER_BIT_B(hash) (((hash) >> 16) & (RTB_STYLE_FILTER_BITS - 1))
+
+#define FILTER_TEST(f, bit) ((f)->bits[(bit) >> 5] & (1u << ((bit) & 31)))
+#define FILTER_SET(f, bit)  ((f)->bits[(bit) >> 5] |= (1u << ((bit) & 31)))
+
+static void
+filter_add(struct rtb_style_filter *f, uint32_t hash)
+{
+	FILTER_SET(f, FILTER_BIT_A(hash));
+	FILTER_SET(f, FILTER_BIT_B(hash));
+}
+
+static int
+filter_may_contain(const struct rtb_style_filter *f, uint32_t hash)
+{
+	return FILTER_TEST(f, FILTER_BIT_A(hash))
+		&& FILTER_TEST(f, FILTER_BIT_B(hash));
+}
+
+static uint32_t
+type_hash(struct rtb_type_atom_descriptor *type)
+{
+	if (!type->style_hash)
+		type->style_hash = rtb_style_hash(type->name);
 
-	draw_state = draw_state_for_elem_state(elem_state);
+	return type->style_hash;
+}
+
+static void
+filter_add_elem(struct rtb_style_filter *f, struct rtb_element *elem)
+{
+	size_t i;
+
+	if (elem->type)
+		for (i = 0; i <= elem->type->depth; i++)
+			filter_add(f, type_hash(elem->type->ancestors[i]));
 
-	for (; style_list; style_list = style_list->inherit_from) {
-		prop = style_list->properties[draw_state];
+	if (elem->style_id.name)
+		filter_add(f, elem->style_id.hash);
 
-		for (; !!prop->property_name; prop++)
-			if (!strcmp(prop->property_name, property_name)
-					&& prop->type == type)
-				return prop;
+	for (i = 0; i < elem->classes.size; i++)
+		filter_add(f, elem->classes.data[i].hash);
+}
+
+/* 0 if some ancestor compound of `sel` names something that definitely
+ * isn't anywhere above the subject. */
+static int
+filter_may_match(const struct rtb_style_filter *f,
+		const struct rtb_style_selector *sel)
+{
+	const struct rtb_style_compound *compound;
+	const struct rtb_style_name *class;
+	int i;
+
+	for (i = 1; i < sel->ncompounds; i++) {
+		compound = &sel->compounds[i];
+
+		if (compound->type.name
+				&& !filter_may_contain(f, compound->type.hash))
+			return 0;
+
+		if (compound->id.name
+				&& !filter_may_contain(f, compound->id.hash))
+			return 0;
+
+		for (class = compound->classes; class && class->name; class++)
+			if (!filter_may_contain(f, class->hash))
+				return 0;
 	}
 
-	return NULL;
+	return 1;
+}
+
+static int
+elem_has_name(struct rtb_element *elem, rtb_style_selector_kind_t kind,
+		const struct rtb_style_name *name)
+{
+	size_t i;
+
+	if (kind == RTB_STYLE_SELECTOR_ID)
+		return elem->style_id.name
+			&& elem->style_id.hash == name->hash
+			&& !strcmp(elem->style_id.name, name->name);
+
+	for (i = 0; i < elem->classes.size; i++)
+		if (elem->classes.data[i].hash == name->hash
+				&& !strcmp(elem->classes.data[i].name, name->name))
+			return 1;
+
+	return 0;
+}
+
+static int
+compound_matches(struct rtb_element *elem,
+		const struct rtb_style_compound *compound)
+{
+	const struct rtb_style_name *class;
+
+	if (compound->id.name
+			&& !elem_has_name(elem, RTB_STYLE_SELECTOR_ID, &compound->id))
+		return 0;
+
+	for (class = compound->classes; class && class->name; class++)
+		if (!elem_has_name(elem, RTB_STYLE_SELECTOR_CLASS, class))
+			return 0;
+
+	return type_matches(elem->type, &compound->type);
+}
+
+/* compounds[idx...] against the ancestors of `elem`, right to left. */
+static int
+ancestors_match(struct rtb_element *elem,
+		const struct rtb_style_selector *sel, int idx)
+{
+	if (idx == sel->ncompounds)
+		return 1;
+
+	for (elem = PARENT_OF(elem); elem; elem = PARENT_OF(elem))
+		if (compound_matches(elem, &sel->compounds[idx])
+				&& ancestors_match(elem, sel, idx + 1))
+			return 1;
+
+	return 0;
+}
+
+static struct rtb_style **
+elem_candidate_rules(struct rtb_element *elem)
+{
+	struct rtb_style_type_cache *cache;
+
+	if (!elem->type || !elem->window)
+		return NULL;
+
+	/* refreshes the type's cache if the style list changed */
+	style_for_descriptor(elem->window, elem->window->style_list, elem->type);
+	cache = type_cache(elem->window, elem->type);
+
+	return cache ? cache->rules : NULL;
+}
+
+static void
+add_matched_rule(struct rtb_element *elem, struct rtb_style *rule)
+{
+	size_t i;
+
+	if (!elem->matched_rules.data)
+		VECTOR_INIT(&elem->matched_rules, &stdlib_allocator, 4);
+
+	/* later rules win ties, same as in CSS. */
+	for (i = 0; i < elem->matched_rules.size; i++)
+		if (elem->matched_rules.data[i]->selector->specificity
+				<= rule->selector->specificity)
+			break;
+
+	VECTOR_INSERT(&elem->matched_rules, i, &rule);
+}
+
+void
+rtb_style_match_rules(struct rtb_element *elem)
+{
+	const struct rtb_style_selector *sel;
+	struct rtb_element *parent;
+	struct rtb_style **rule;
+
+	parent = PARENT_OF(elem);
+
+	if (parent)
+		elem->style_filter = parent->style_filter;
+	else
+		memset(&elem->style_filter, 0, sizeof(elem->style_filter));
+
+	if (elem->matched_rules.data)
+		VECTOR_CLEAR(&elem->matched_rules);
+
+	for (rule = elem_candidate_rules(elem); rule && *rule; rule++) {
+		sel = (*rule)->selector;
+
+		if (!compound_matches(elem, &sel->compounds[0]))
+			continue;
+
+		if (sel->ncompounds > 1 && (!parent
+					|| !filter_may_match(&parent->style_filter, sel)
+					|| !ancestors_match(elem, sel, 1)))
+			continue;
+
+		add_matched_rule(elem, *rule);
+	}
+
+	filter_add_elem(&elem->style_filter, elem);
+}
+
+/* where in a rule's selector a class or id shows up. */
+#define IN_SUBJECT  0x1
+#define IN_ANCESTOR 0x2
+
+static unsigned int
+rule_mentions(const struct rtb_style *rule, rtb_style_selector_kind_t kind,
+		const struct rtb_style_name *name)
+{
+	const struct rtb_style_compound *compound;
+	const struct rtb_style_name *class;
+	unsigned int where = 0;
+	int i;
+
+	for (i = 0; i < rule->selector->ncompounds; i++) {
+		compound = &rule->selector->compounds[i];
+
+		if (kind == RTB_STYLE_SELECTOR_ID) {
+			if (compound->id.name && compound->id.hash == name->hash
+					&& !strcmp(compound->id.name, name->name))
+				where |= i ? IN_ANCESTOR : IN_SUBJECT;
+			continue;
+		}
+
+		for (class = compound->classes; class && class->name; class++)
+			if (class->hash == name->hash
+					&& !strcmp(class->name, name->name))
+				where |= i ? IN_ANCESTOR : IN_SUBJECT;
+	}
+
+	return where;
+}
+
+/* walks the subtree under `elem` after `name` changed on it. filters are
+ * refreshed all the way down, since every descendant's filter includes
+ * `elem`'s names, but only elements that are candidates for a rule using
+ * `name` in an ancestor position get rematched and restyled. */
+static void
+invalidate_descendants(struct rtb_element *elem,
+		rtb_style_selector_kind_t kind, const struct rtb_style_name *name)
+{
+	struct rtb_element *iter;
+	struct rtb_style **rule;
+
+	TAILQ_FOREACH(iter, &elem->children, child) {
+		for (rule = elem_candidate_rules(iter); rule && *rule; rule++)
+			if (rule_mentions(*rule, kind, name) & IN_ANCESTOR)
+				break;
+
+		if (rule && *rule) {
+			iter->style_stale = 1;
+			iter->impl->restyle(iter);
+		} else {
+			iter->style_filter = elem->style_filter;
+			filter_add_elem(&iter->style_filter, iter);
+		}
+
+		invalidate_descendants(iter, kind, name);
+	}
 }
 
+void
+rtb_style_invalidate(struct rtb_element *elem,
+		rtb_style_selector_kind_t kind, const char *name_str)
+{
+	struct rtb_style_name name;
+	unsigned int where;
+	struct rtb_style *s;
+
+	/* unattached elements get matched when they're attached */
+	if (elem->state == RTB_STATE_UNATTACHED || !elem->window
+			|| elem->window->state == RTB_STATE_UNATTACHED)
+		return;
+
+	name.name = name_str;
+	name.hash = rtb_style_hash(name_str);
+	where = 0;
+
+	/* the invalidation set: which rules `name` can affect, and whether
+	 * through the element itself or through its descendants. */
+	for (s = elem->window->style_list; s->for_type; s++)
+		if (s->selector)
+			where |= rule_mentions(s, kind, &name);
+
+	if (!where)
+		return;
+
+	elem->style_stale = 1;
+	elem->impl->restyle(elem);
+
+	if (where & IN_ANCESTOR)
+		invalidate_descendants(elem, kind, &name);
+}
+
+/**
+ * queries
+ */
+
 static const struct rtb_style_property_definition *
-query(struct rtb_style *style_list, rtb_elem_state_t elem_state,
-		const char *property_name, rtb_style_prop_type_t type,
-		int return_fallback)
+lookup(struct rtb_style *style, rtb_elem_state_t elem_state,
+		rtb_style_prop_id_t prop_id)
+{
+	if (style && style->lookup[elem_state] && prop_id >= 0)
+		return style->lookup[elem_state][prop_id];
+	return NULL;
+}
+
+const struct rtb_style_property_definition *
+rtb_style_elem_lookup(struct rtb_element *elem, rtb_style_prop_id_t prop_id)
 {
 	const struct rtb_style_property_definition *prop;
+	struct rtb_style **rules;
+	size_t i, nrules;
 
-	if ((prop = query_no_fallback(style_list,
-					elem_state, property_name, type)))
-		return prop;
+	rules  = elem->matched_rules.data;
+	nrules = elem->matched_rules.size;
 
-	switch (elem_state) {
-	case RTB_STATE_FOCUS_HOVER:
-	case RTB_STATE_FOCUS_ACTIVE:
-		if ((prop = query_no_fallback(style_list,
-						RTB_STATE_FOCUS, property_name, type)))
+	for (i = 0; i < nrules
+			&& rules[i]->selector->specificity >= RTB_STYLE_TYPE_SPECIFICITY;
+			i++)
+		if ((prop = lookup(rules[i], elem->state, prop_id)))
 			return prop;
 
-		/* fall-through */
+	if ((prop = lookup(elem->style, elem->state, prop_id)))
+		return prop;
 
-	case RTB_STATE_FOCUS:
-	case RTB_STATE_HOVER:
-	case RTB_STATE_ACTIVE:
-		if ((prop = query_no_fallback(style_list,
-						RTB_STATE_NORMAL, property_name, type)))
+	for (; i < nrules; i++)
+		if ((prop = lookup(rules[i], elem->state, prop_id)))
 			return prop;
 
-	default:
-		break;
-	}
+	return NULL;
+}
+
+static const struct rtb_style_property_definition *
+query_elem(struct rtb_element *elem, rtb_style_prop_id_t prop_id,
+		rtb_style_prop_type_t type, int return_fallback)
+{
+	const struct rtb_style_property_definition *prop;
+
+	prop = rtb_style_elem_lookup(elem, prop_id);
+
+	if (prop && prop->type == type)
+		return prop;
 
 	if (return_fallback)
 		return &fallbacks[type];
@@ -242,24 +986,63 @@ query(struct rtb_style *style_list, rtb_elem_state_t elem_state,
 }
 
 const struct rtb_style_property_definition *rtb_style_query_prop(
-		struct rtb_element *elem, const char *property_name,
+		struct rtb_element *elem, rtb_style_prop_id_t prop_id,
 		rtb_style_prop_type_t type, int should_return_fallback)
 {
-	return query(elem->style, elem->state,
-			property_name, type, should_return_fallback);
+	return query_elem(elem, prop_id, type, should_return_fallback);
+}
+
+static int
+is_inherited(rtb_style_prop_id_t prop_id)
+{
+	return prop_id >= 0 && prop_id < RTB_PROP_BUILTIN_COUNT
+		&& (RTB_STYLE_INHERITED_PROPS & RTB_PROP_BIT(prop_id));
 }
 
 const struct rtb_style_property_definition *rtb_style_query_prop_in_tree(
-		struct rtb_element *leaf, const char *property_name,
+		struct rtb_element *leaf, rtb_style_prop_id_t prop_id,
 		rtb_style_prop_type_t type, int should_return_fallback)
 {
-	const struct rtb_style_property_definition *prop;
+	const struct rtb_style_property_definition *prop = NULL;
+
+	if (is_inherited(prop_id)) {
+		/* restyle has already propagated these down the tree, so the
+		 * answer is sitting in the leaf's computed style. */
+		prop = leaf->computed_style[prop_id];
+	} else {
+		for (; leaf && !prop;
+				leaf = (leaf->parent != leaf) ? leaf->parent : NULL)
+			prop = query_elem(leaf, prop_id, type, 0);
+	}
+
+	if (prop && prop->type == type)
+		return prop;
+
+	if (should_return_fallback)
+		return &fallbacks[type];
+	return NULL;
+}
+
+const struct rtb_style_property_definition *const *
+rtb_style_snapshot(struct rtb_style *style, rtb_elem_state_t state)
+{
+	if (!style)
+		return NULL;
+
+	return (const struct rtb_style_property_definition *const *)
+		style->lookup[state];
+}
 
-	for (prop = NULL; !prop && leaf->parent != leaf; leaf = leaf->parent)
-		prop = query(leaf->style, leaf->state,
-				property_name, type, should_return_fallback);
+int
+rtb_style_prop_id(struct rtb_window *win, const char *property_name)
+{
+	size_t i;
 
-	return prop;
+	for (i = 0; i < win->style_nprops; i++)
+		if (!strcmp(win->style_prop_names[i], property_name))
+			return i;
+
+	return -1;
 }
 
 int
@@ -281,27 +1064,273 @@ rtb_style_elem_has_properties_for_state(struct rtb_element *elem,
 int
 rtb_style_resolve_list(struct rtb_window *win, struct rtb_style *style_list)
 {
-	int i, unresolved_styles;
+	struct rtb_type_atom_descriptor *type;
+	int unresolved_styles;
 	struct rtb_style *s;
 
 	unresolved_styles = 0;
 
-	for (i = 0; style_list[i].for_type; i++) {
-		s = &style_list[i];
+	/* resolve whatever we can up front so that assets get loaded now
+	 * rather than on first use. styles for types that don't exist yet
+	 * are resolved when an element of that type is first styled. */
+	for (s = style_list; s->for_type; s++) {
+		if (s->selector) {
+			if (rule_resolve(win, s))
+				printf("rutabaga: couldn't resolve rule for %s\n",
+						s->for_type);
+			continue;
+		}
 
-		if (style_resolve(win, s))
+		if (!(type = rtb_type_lookup(s->for_type))) {
 			unresolved_styles++;
+			continue;
+		}
+
+		style_for_descriptor(win, style_list, type);
+	}
+
+	return unresolved_styles;
+}
+
+static int
+names_equal(const struct rtb_style_name *a, const struct rtb_style_name *b)
+{
+	if (!a->name || !b->name)
+		return a->name == b->name;
+
+	return a->hash == b->hash && !strcmp(a->name, b->name);
+}
+
+static int
+selectors_equal(const struct rtb_style_selector *a,
+		const struct rtb_style_selector *b)
+{
+	const struct rtb_style_name *ca, *cb;
+	int i;
+
+	if (!a || !b)
+		return a == b;
+
+	if (a->ncompounds != b->ncompounds)
+		return 0;
+
+	for (i = 0; i < a->ncompounds; i++) {
+		if (!names_equal(&a->compounds[i].type, &b->compounds[i].type)
+				|| !names_equal(&a->compounds[i].id, &b->compounds[i].id))
+			return 0;
+
+		ca = a->compounds[i].classes;
+		cb = b->compounds[i].classes;
+
+		for (; ca && cb && ca->name && cb->name; ca++, cb++)
+			if (!names_equal(ca, cb))
+				return 0;
+
+		if ((ca && ca->name) || (cb && cb->name))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+theme_init(struct rtb_window *win, struct rtb_style_theme *theme,
+		struct rtb_style_data data)
+{
+	const struct rtb_style_property_definition *prop;
+	const struct rtb_style_font_definition **defs;
+	struct rtb_style *s, *ts;
+	rtb_draw_state_t state;
+	size_t i;
+
+	memset(theme, 0, sizeof(*theme));
+	theme->data = data;
+
+	for (s = win->style_list; s->for_type; s++)
+		theme->ncounterparts++;
+
+	theme->counterparts = calloc(theme->ncounterparts + 1,
+			sizeof(*theme->counterparts));
+	theme->prop_map = calloc(data.nprops + 1, sizeof(*theme->prop_map));
+	theme->fonts = calloc(data.nfonts + 1, sizeof(*theme->fonts));
+
+	if (!theme->counterparts || !theme->prop_map || !theme->fonts)
+		return -1;
+
+	for (i = 0; i < data.nprops; i++)
+		theme->prop_map[i] = rtb_style_prop_id(win, data.prop_names[i]);
+
+	for (i = 0, s = win->style_list; s->for_type; s++, i++)
+		for (ts = data.style; ts->for_type; ts++)
+			if (!strcmp(s->for_type, ts->for_type)
+					&& selectors_equal(s->selector, ts->selector))
+				theme->counterparts[i] = ts;
+
+	for (ts = data.style; ts->for_type; ts++) {
+		for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+			for (prop = ts->properties[state]; prop->property_name; prop++) {
+				if (prop->type != RTB_STYLE_PROP_FONT)
+					continue;
+
+				defs = realloc(theme->font_defs,
+						(theme->nfont_defs + 1) * sizeof(*defs));
+				if (!defs)
+					return -1;
+
+				theme->font_defs = defs;
+				theme->font_defs[theme->nfont_defs++] = &prop->font;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void
+theme_fini(struct rtb_style_theme *theme)
+{
+	free(theme->counterparts);
+	free(theme->prop_map);
+	free(theme->fonts);
+	free(theme->font_defs);
+}
+
+int
+rtb_style_add_theme(struct rtb_window *win, struct rtb_style_data data)
+{
+	struct rtb_style_theme *themes, *theme;
+	struct rtb_style *ts;
+	int i;
+
+	themes = realloc(win->style_themes,
+			(win->style_nthemes + 1) * sizeof(*themes));
+	if (!themes)
+		return -1;
+
+	win->style_themes = themes;
+	theme = &themes[win->style_nthemes];
+
+	if (theme_init(win, theme, data)) {
+		theme_fini(theme);
+		return -1;
 	}
 
-	for (i = 0; style_list[i].for_type; i++) {
-		s = &style_list[i];
-		if (!s->resolved_type)
+	win->style_nthemes++;
+
+	/* assets are loaded once, up front, for every style that will
+	 * actually be layered over one of the window's. */
+	for (i = 0; (size_t) i < theme->ncounterparts; i++)
+		if ((ts = theme->counterparts[i]))
+			style_load_assets(win, ts);
+
+	return win->style_nthemes;
+}
+
+/* restyles the elements whose style or matched rules changed tables.
+ * inherited properties are carried down by restyle itself, which stamps
+ * every element it gets to with the window's theme_pass, so those aren't
+ * restyled a second time here. */
+static void
+restyle_themed(struct rtb_element *elem)
+{
+	struct rtb_element *iter;
+	int changed;
+	size_t i;
+
+	changed = elem->style_pass != elem->window->theme_pass
+		&& elem->style && elem->style->theme_changed;
+
+	for (i = 0; !changed && i < elem->matched_rules.size; i++)
+		changed = elem->style_pass != elem->window->theme_pass
+			&& elem->matched_rules.data[i]->theme_changed;
+
+	if (changed)
+		elem->impl->restyle(elem);
+
+	TAILQ_FOREACH(iter, &elem->children, child)
+		restyle_themed(iter);
+}
+
+int
+rtb_style_set_theme(struct rtb_window *win, int theme)
+{
+	size_t table_size;
+	struct rtb_style *s;
+
+	if (theme < 0 || theme > win->style_nthemes)
+		return -1;
+
+	if (theme == win->style_theme)
+		return 0;
+
+	table_size = win->style_nprops * RTB_STYLE_STATE_COUNT;
+	win->style_theme = theme;
+	win->style_generation++;
+	win->theme_pass++;
+
+	/* styles that haven't been resolved yet will pick up the new theme
+	 * when they are. */
+	for (s = win->style_list; s->for_type; s++) {
+		s->theme_changed = 0;
+
+		if (!s->lookup[0])
+			continue;
+
+		if (theme_tables(win, s, theme)) {
+			printf("rutabaga: couldn't build theme tables for %s\n",
+					s->for_type);
 			continue;
+		}
+
+		if (!tables_equal(s->lookup[0], s->theme_lookup[theme][0],
+					table_size))
+			s->theme_changed = 1;
 
-		s->inherit_from = inherits_from(s->resolved_type, style_list);
+		memcpy(s->lookup, s->theme_lookup[theme], sizeof(s->lookup));
 	}
 
-	return unresolved_styles;
+	if (win->state != RTB_STATE_UNATTACHED)
+		restyle_themed(RTB_ELEMENT(win));
+
+	return 0;
+}
+
+void
+rtb_style_free_themes(struct rtb_window *win)
+{
+	int i;
+
+	for (i = 0; i < win->style_nthemes; i++)
+		theme_fini(&win->style_themes[i]);
+
+	free(win->style_themes);
+	win->style_themes = NULL;
+	win->style_nthemes = 0;
+	win->style_theme = 0;
+}
+
+void
+rtb_style_free_type_cache(struct rtb_window *win)
+{
+	unsigned int i;
+
+	for (i = 0; i < win->style_type_cache_size; i++)
+		free(win->style_type_cache[i].rules);
+
+	free(win->style_type_cache);
+	win->style_type_cache = NULL;
+	win->style_type_cache_size = 0;
+}
+
+void
+rtb_style_free_list(struct rtb_style *style_list)
+{
+	struct rtb_style *s;
+
+	for (s = style_list; s->for_type; s++)
+		free_lookup(s);
+
+	free(style_list);
 }
 
 void
@@ -310,7 +1339,8 @@ rtb_style_apply_to_tree(struct rtb_element *root, struct rtb_style *style_list)
 	struct rtb_element *iter;
 
 	if (!root->style)
-		root->style = style_for_type(RTB_TYPE_ATOM(root), style_list);
+		root->style = style_for_descriptor(root->window, style_list,
+				root->type);
 
 	TAILQ_FOREACH(iter, &root->children, child)
 		rtb_style_apply_to_tree(iter, style_list);
@@ -319,13 +1349,25 @@ rtb_style_apply_to_tree(struct rtb_element *root, struct rtb_style *style_list)
 struct rtb_style *
 rtb_style_for_element(struct rtb_element *elem, struct rtb_style *style_list)
 {
-	return style_for_type(RTB_TYPE_ATOM(elem), style_list);
+	return style_for_descriptor(elem->window, style_list, elem->type);
 }
 
 struct rtb_font *
 rtb_style_get_font_for_def(struct rtb_window *win,
 		const struct rtb_style_font_definition *def)
 {
+	struct rtb_style_theme *theme;
+	size_t i;
+	int t;
+
+	for (t = 0; t < win->style_nthemes; t++) {
+		theme = &win->style_themes[t];
+
+		for (i = 0; i < theme->nfont_defs; i++)
+			if (theme->font_defs[i] == def)
+				return &theme->fonts[def->slot];
+	}
+
 	return &win->style_fonts[def->slot];
 }
 
@@ -336,7 +1378,10 @@ rtb_style_get_defaults(void)
 	memcpy(stlist, default_style, default_style_size);
 
 	return (struct rtb_style_data) {
-		.style = stlist,
-		.nfonts	= default_style_fonts
+		.style  = stlist,
+		.nfonts	= default_style_fonts,
+
+		.prop_names = default_style_props,
+		.nprops     = default_style_nprops
 	};
 }
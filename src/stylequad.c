@@ -33,15 +33,21 @@
 #include <rutabaga/window.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 
 /**
  * drawing
  */
 
+static void upload_geometry(struct rtb_stylequad *self);
+
 static void
-draw_solid(const struct rtb_stylequad *self, const struct rtb_shader *shader,
+draw_solid(struct rtb_stylequad *self, const struct rtb_shader *shader,
 		GLenum mode, GLuint ibo, GLsizei count)
 {
+	if (self->geometry_stale)
+		upload_geometry(self);
+
 	glBindBuffer(GL_ARRAY_BUFFER, self->vertices);
 	glEnableVertexAttribArray(shader->vertex);
 	glVertexAttribPointer(shader->vertex, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -56,7 +62,7 @@ draw_solid(const struct rtb_stylequad *self, const struct rtb_shader *shader,
 
 static void
 draw_textured(struct rtb_render_context *ctx,
-		const struct rtb_stylequad *self,
+		struct rtb_stylequad *self,
 		const struct rtb_stylequad_texture *tx, int border)
 {
 	const struct rtb_shader *shader = ctx->shader;
@@ -87,7 +93,7 @@ draw_textured(struct rtb_render_context *ctx,
 }
 
 static void
-draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
+draw(struct rtb_render_context *ctx, struct rtb_stylequad *self,
 		const struct rtb_point *center, rtb_stylequad_draw_mode_t mode)
 {
 	const struct rtb_shader *shader = ctx->shader;
@@ -106,13 +112,13 @@ draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
 				ctx->window->local_storage.ibo.stylequad.solid, 4);
 	}
 
-	if (self->background_image.definition
+	if (self->textures && self->textures->background_image.definition
 			&& (mode & RTB_STYLEQUAD_DRAW_BG_IMAGE))
-		draw_textured(ctx, self, &self->background_image, 0);
+		draw_textured(ctx, self, &self->textures->background_image, 0);
 
-	if (self->border_image.definition
+	if (self->textures && self->textures->border_image.definition
 			&& (mode & RTB_STYLEQUAD_DRAW_BORDER_IMAGE))
-		draw_textured(ctx, self, &self->border_image, 1);
+		draw_textured(ctx, self, &self->textures->border_image, 1);
 
 	if (self->properties.border_color
 			&& mode & RTB_STYLEQUAD_DRAW_BORDER_COLOR) {
@@ -130,7 +136,7 @@ draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
 }
 
 void
-rtb_stylequad_draw(const struct rtb_stylequad *self,
+rtb_stylequad_draw(struct rtb_stylequad *self,
 		struct rtb_render_context *ctx, const struct rtb_point *center,
 		rtb_stylequad_draw_mode_t mode)
 {
@@ -138,7 +144,7 @@ rtb_stylequad_draw(const struct rtb_stylequad *self,
 }
 
 void
-rtb_stylequad_draw_solid(const struct rtb_stylequad *self,
+rtb_stylequad_draw_solid(struct rtb_stylequad *self,
 		struct rtb_render_context *ctx, const struct rtb_point *center)
 {
 	const struct rtb_shader *shader = ctx->shader;
@@ -268,16 +274,31 @@ load_texture(struct rtb_stylequad_texture *dst,
 	return 0;
 }
 
+static int
+alloc_textures(struct rtb_stylequad *self,
+		const struct rtb_style_texture_definition *tx)
+{
+	/* clearing an image we never had is a no-op */
+	if (self->textures || !tx)
+		return !self->textures;
+
+	self->textures = slab_allocator.calloc(1, sizeof(*self->textures));
+	return !self->textures;
+}
+
 int
 rtb_stylequad_set_border_image(struct rtb_stylequad *self,
 		const struct rtb_style_texture_definition *tx)
 {
-	if (load_texture(&self->border_image, tx))
+	if (alloc_textures(self, tx)
+			|| load_texture(&self->textures->border_image, tx))
 		return -1;
 
 	if (tx)
-		set_border_tex_coords(&self->border_image);
+		set_border_tex_coords(&self->textures->border_image);
 
+	/* the border image changes how the quad is cut up */
+	self->geometry_stale = 1;
 	return 0;
 }
 
@@ -285,11 +306,12 @@ int
 rtb_stylequad_set_background_image(struct rtb_stylequad *self,
 		const struct rtb_style_texture_definition *tx)
 {
-	if (load_texture(&self->background_image, tx))
+	if (alloc_textures(self, tx)
+			|| load_texture(&self->textures->background_image, tx))
 		return -1;
 
 	if (tx)
-		set_background_tex_coords(&self->background_image);
+		set_background_tex_coords(&self->textures->background_image);
 
 	return 0;
 }
@@ -320,34 +342,31 @@ rtb_stylequad_set_border_color(struct rtb_stylequad *self,
  * updating vertices
  */
 
-void
-rtb_stylequad_update_geometry(struct rtb_stylequad *self,
-		const struct rtb_rect *rect)
+static void
+upload_geometry(struct rtb_stylequad *self)
 {
+	const struct rtb_style_texture_definition *border = NULL;
 	struct rtb_rect r;
 
-	/* the coordinates for a stylequad are arranged around the center
-	 * so that it's easier to manipulate the geometry using a modelview
-	 * matrix at draw-time. */
-
-	r.x  = -(rect->w / 2.f);
-	r.y  = -(rect->h / 2.f);
+	r.x  = -(self->size.w / 2.f);
+	r.y  = -(self->size.h / 2.f);
 	r.x2 = -r.x;
 	r.y2 = -r.y;
 
-	self->offset.x = rect->x + r.x2;
-	self->offset.y = rect->y + r.y2;
+	if (!self->vertices)
+		glGenBuffers(1, &self->vertices);
 
 	glBindBuffer(GL_ARRAY_BUFFER, self->vertices);
 
-	if (self->border_image.definition) {
-		const struct rtb_style_texture_definition *tx =
-			self->border_image.definition;
+	if (self->textures)
+		border = self->textures->border_image.definition;
+
+	if (border) {
 		unsigned int
-			bdr_top = tx->border.top,
-			bdr_rgt = tx->border.right,
-			bdr_btm = tx->border.bottom,
-			bdr_lft = tx->border.left;
+			bdr_top = border->border.top,
+			bdr_rgt = border->border.right,
+			bdr_btm = border->border.bottom,
+			bdr_lft = border->border.left;
 
 		GLfloat v[16][2] = {
 			{r.x,            r.y},
@@ -384,18 +403,29 @@ rtb_stylequad_update_geometry(struct rtb_stylequad *self,
 	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	self->geometry_stale = 0;
+}
+
+void
+rtb_stylequad_update_geometry(struct rtb_stylequad *self,
+		const struct rtb_rect *rect)
+{
+	/* the coordinates for a stylequad are arranged around the center
+	 * so that it's easier to manipulate the geometry using a modelview
+	 * matrix at draw-time. */
+
+	self->offset.x = rect->x + (rect->w / 2.f);
+	self->offset.y = rect->y + (rect->h / 2.f);
+
+	self->size.w = rect->w;
+	self->size.h = rect->h;
+	self->geometry_stale = 1;
 }
 
 /**
  * lifecycle
  */
 
-#define INIT_STYLEQUAD_TEXTURE(tx) do {										\
-	(tx)->definition = NULL;												\
-	(tx)->coords    = 0;													\
-	(tx)->gl_handle = 0;													\
-} while (0)
-
 #define FINI_STYLEQUAD_TEXTURE(tx) do {										\
 	if ((tx)->coords) {														\
 		glDeleteBuffers(1, &(tx)->coords);									\
@@ -407,16 +437,18 @@ void
 rtb_stylequad_init(struct rtb_stylequad *self)
 {
 	memset(self, 0, sizeof(*self));
-	glGenBuffers(1, &self->vertices);
-
-	INIT_STYLEQUAD_TEXTURE(&self->border_image);
-	INIT_STYLEQUAD_TEXTURE(&self->background_image);
 }
 
 void rtb_stylequad_fini(struct rtb_stylequad *self)
 {
-	FINI_STYLEQUAD_TEXTURE(&self->border_image);
-	FINI_STYLEQUAD_TEXTURE(&self->background_image);
+	if (self->textures) {
+		FINI_STYLEQUAD_TEXTURE(&self->textures->border_image);
+		FINI_STYLEQUAD_TEXTURE(&self->textures->background_image);
+
+		slab_allocator.free(self->textures);
+		self->textures = NULL;
+	}
 
-	glDeleteBuffers(1, &self->vertices);
+	if (self->vertices)
+		glDeleteBuffers(1, &self->vertices);
 }
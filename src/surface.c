@@ -37,6 +37,7 @@
 
 #include "rtb_private/util.h"
 #include "rtb_private/layout-debug.h"
+#include "rtb_private/stdlib-allocator.h"
 
 #define SELF_FROM(elem) \
 	struct rtb_surface *self = RTB_ELEMENT_AS(elem, rtb_surface)
@@ -46,6 +47,245 @@
  */
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation surface_impl;
+static struct rtb_type_atom_descriptor surface_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.surface");
+
+/**
+ * occlusion
+ */
+
+static int
+is_occluded(struct rtb_surface *self, const struct rtb_rect *rect)
+{
+	const struct rtb_rect *occ;
+	size_t i;
+
+	for (i = 0; i < self->occluders.size; i++) {
+		occ = &self->occluders.data[i];
+
+		if (occ->x <= rect->x && occ->y <= rect->y
+				&& occ->x2 >= rect->x2 && occ->y2 >= rect->y2)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* walks the tree front to back (the reverse of the order we draw it in),
+ * so by the time we get to an element, self->occluders holds everything
+ * opaque that gets drawn over it. */
+static void
+find_occluded(struct rtb_surface *self, struct rtb_element *elem)
+{
+	struct rtb_element *iter;
+
+	TAILQ_FOREACH_REVERSE(iter, &elem->children, children, child) {
+		/* a nested surface sorts out its own children. */
+		if (iter->surface != self)
+			return;
+
+		if (rtb_elem_visibility(iter) == RTB_FULLY_OBSCURED)
+			continue;
+
+		iter->occluded = is_occluded(self, &iter->clip_rect);
+		if (iter->occluded)
+			continue;
+
+		find_occluded(self, iter);
+
+		if (iter->opaque)
+			VECTOR_PUSH_BACK(&self->occluders, &iter->clip_rect);
+	}
+}
+
+/* elements which got hidden along with an ancestor weren't looked at by
+ * the last pass, so their own flag may be stale. */
+static int
+in_occluded_subtree(struct rtb_surface *self, struct rtb_element *elem)
+{
+	for (; elem && elem != RTB_ELEMENT(self); elem = elem->parent)
+		if (elem->occluded)
+			return 1;
+
+	return 0;
+}
+
+/**
+ * render queue
+ */
+
+static int
+is_queued(struct rtb_element *elem)
+{
+	return elem->render_entry.tqe_prev != NULL;
+}
+
+static void
+dequeue(struct rtb_surface *self, struct rtb_element *elem)
+{
+	TAILQ_REMOVE(&self->render_queue, elem, render_entry);
+
+	elem->render_entry.tqe_next = NULL;
+	elem->render_entry.tqe_prev = NULL;
+}
+
+static int
+rooted_in(struct rtb_surface *self, struct rtb_element *elem)
+{
+	for (; elem; elem = elem->parent)
+		if (elem == RTB_ELEMENT(self))
+			return 1;
+
+	return 0;
+}
+
+/* detached() dequeues elements as they leave the tree, but whatever is
+ * left over that isn't under us any more can't be placed or drawn. the
+ * rest of the tidying up relies on this having been done first. */
+static void
+drop_unrooted(struct rtb_surface *self)
+{
+	struct rtb_element *iter, *next;
+
+	TAILQ_FOREACH_SAFE(iter, &self->render_queue, render_entry, next)
+		if (!rooted_in(self, iter))
+			dequeue(self, iter);
+}
+
+/* anything with a queued ancestor gets redrawn along with it. */
+static void
+prune_descendants(struct rtb_surface *self)
+{
+	struct rtb_element *iter, *next, *ancestor;
+
+	TAILQ_FOREACH_SAFE(iter, &self->render_queue, render_entry, next) {
+		for (ancestor = iter->parent;
+				ancestor && ancestor != RTB_ELEMENT(self);
+				ancestor = ancestor->parent) {
+			if (is_queued(ancestor)) {
+				dequeue(self, iter);
+				break;
+			}
+		}
+	}
+}
+
+/* if at least half of an element's children are queued, it's cheaper to
+ * clear and redraw the element once than each of them separately.
+ * queued elements never have an opaque ancestor inside the surface (see
+ * rtb_elem_nearest_clearable()), so their parent is always clearable. */
+static int
+merge_siblings(struct rtb_surface *self)
+{
+	struct rtb_element *iter, *other, *parent;
+	unsigned int queued, children;
+
+	TAILQ_FOREACH(iter, &self->render_queue, render_entry) {
+		parent = iter->parent;
+
+		if (!parent || parent == RTB_ELEMENT(self) || is_queued(parent))
+			continue;
+
+		queued = 0;
+		TAILQ_FOREACH(other, &self->render_queue, render_entry)
+			if (other->parent == parent)
+				queued++;
+
+		if (queued < 2)
+			continue;
+
+		children = 0;
+		TAILQ_FOREACH(other, &parent->children, child)
+			children++;
+
+		if (queued * 2 < children)
+			continue;
+
+		TAILQ_INSERT_TAIL(&self->render_queue, parent, render_entry);
+		return 1;
+	}
+
+	return 0;
+}
+
+static unsigned int
+depth_in(struct rtb_surface *self, struct rtb_element *elem)
+{
+	unsigned int depth = 0;
+
+	for (; elem && elem != RTB_ELEMENT(self); elem = elem->parent)
+		depth++;
+
+	return depth;
+}
+
+/* whether a gets drawn before b. */
+static int
+drawn_before(struct rtb_surface *self,
+		struct rtb_element *a, struct rtb_element *b)
+{
+	unsigned int a_depth = depth_in(self, a), b_depth = depth_in(self, b);
+
+	for (; a_depth > b_depth; a_depth--)
+		a = a->parent;
+	for (; b_depth > a_depth; b_depth--)
+		b = b->parent;
+
+	while (a && b && a->parent != b->parent) {
+		a = a->parent;
+		b = b->parent;
+	}
+
+	if (!a || !b)
+		return 0;
+
+	for (; a; a = TAILQ_NEXT(a, child))
+		if (a == b)
+			return 1;
+
+	return 0;
+}
+
+/* puts the queue into the order the tree is drawn in, so that where
+ * queued elements overlap they get painted over each other properly. */
+static void
+sort_render_queue(struct rtb_surface *self)
+{
+	struct rtb_render_tailq sorted;
+	struct rtb_element *iter, *pos;
+
+	TAILQ_INIT(&sorted);
+
+	while ((iter = TAILQ_FIRST(&self->render_queue))) {
+		TAILQ_REMOVE(&self->render_queue, iter, render_entry);
+
+		/* things mostly get queued in tree order already, so we look
+		 * for the insertion point from the back. */
+		TAILQ_FOREACH_REVERSE(pos, &sorted, rtb_render_tailq, render_entry)
+			if (drawn_before(self, pos, iter))
+				break;
+
+		if (pos)
+			TAILQ_INSERT_AFTER(&sorted, pos, iter, render_entry);
+		else
+			TAILQ_INSERT_HEAD(&sorted, iter, render_entry);
+	}
+
+	TAILQ_CONCAT(&self->render_queue, &sorted, render_entry);
+}
+
+static void
+tidy_render_queue(struct rtb_surface *self)
+{
+	drop_unrooted(self);
+	prune_descendants(self);
+
+	while (merge_siblings(self))
+		prune_descendants(self);
+
+	sort_render_queue(self);
+}
 
 /**
  * element implementation
@@ -134,7 +374,7 @@ child_attached(struct rtb_element *elem, struct rtb_element *child)
 	SELF_FROM(elem);
 
 	child->surface = self;
-	child->attached(child, RTB_ELEMENT(self), self->window);
+	child->impl->attached(child, RTB_ELEMENT(self), self->window);
 }
 
 static void
@@ -142,8 +382,7 @@ attached(struct rtb_element *self,
 		struct rtb_element *parent, struct rtb_window *window)
 {
 	super.attached(self, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.surface");
+	self->type = rtb_type_register(&surface_type, self->type);
 }
 
 static void
@@ -218,6 +457,15 @@ rtb_surface_draw_children(struct rtb_surface *self)
 
 	self->render_ctx.window = self->window;
 
+	self->draw_stats.drawn = 0;
+	self->draw_stats.occluded = 0;
+
+	if (self->occlusion_stale) {
+		VECTOR_CLEAR(&self->occluders);
+		find_occluded(self, RTB_ELEMENT(self));
+		self->occlusion_stale = 0;
+	}
+
 	/* we have slightly different ways of handling this redraw depending
 	 * on what the state of the surface is. */
 	switch (self->surface_state) {
@@ -248,12 +496,19 @@ rtb_surface_draw_children(struct rtb_surface *self)
 	case RTB_SURFACE_VALID:
 		/* if we're marked valid, we'll just do an incremental redraw
 		 * just of the elements which have requested it. */
+		tidy_render_queue(self);
+
 		while ((iter = TAILQ_FIRST(&self->render_queue))) {
 			TAILQ_REMOVE(&self->render_queue, iter, render_entry);
 
 			iter->render_entry.tqe_next = NULL;
 			iter->render_entry.tqe_prev = NULL;
 
+			if (in_occluded_subtree(self, iter->parent)) {
+				self->draw_stats.occluded++;
+				continue;
+			}
+
 			rtb_elem_draw(iter, 1);
 		}
 
@@ -277,14 +532,17 @@ rtb_surface_init(struct rtb_surface *self)
 	if (RTB_SUBCLASS(RTB_ELEMENT(self), rtb_elem_init, &super))
 		return -1;
 
-	self->impl = super;
-	self->impl.draw           = draw;
-	self->impl.reflow         = reflow;
-	self->impl.attached       = attached;
-	self->impl.mark_dirty     = mark_dirty;
-	self->impl.child_attached = child_attached;
+	surface_impl = super;
+	surface_impl.draw           = draw;
+	surface_impl.reflow         = reflow;
+	surface_impl.attached       = attached;
+	surface_impl.mark_dirty     = mark_dirty;
+	surface_impl.child_attached = child_attached;
+	self->impl = &surface_impl;
 
 	TAILQ_INIT(&self->render_queue);
+	VECTOR_INIT(&self->occluders, &stdlib_allocator, 8);
+	self->occlusion_stale = 1;
 
 	glGenTextures(1, &self->texture);
 	glGenFramebuffers(1, &self->fbo);
@@ -299,6 +557,7 @@ void
 rtb_surface_fini(struct rtb_surface *self)
 {
 	rtb_quad_fini(&self->quad);
+	VECTOR_FREE(&self->occluders);
 
 	glDeleteFramebuffers(1, &self->fbo);
 	glDeleteTextures(1, &self->texture);
@@ -60,47 +60,209 @@ static const rtb_utf32_t default_cache[] = {
 };
 
 static int
-init_font(struct rtb_font *font, const rtb_utf32_t *cache)
+init_font(texture_font_t *txfont, const rtb_utf32_t *cache)
 {
 	if (0)
-		memcpy(font->txfont->lcd_weights, lcd_weights, sizeof(lcd_weights));
+		memcpy(txfont->lcd_weights, lcd_weights, sizeof(lcd_weights));
 
-	texture_font_load_glyphs(font->txfont, cache ? cache : default_cache);
+	texture_font_load_glyphs(txfont, cache ? cache : default_cache);
 	return 0;
 }
 
+static texture_atlas_t *
+new_atlas(int dpi_x, int dpi_y)
+{
+#if defined(FT_CONFIG_OPTION_SUBPIXEL_RENDERING) || (FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && (FREETYPE_MINOR > 8 || (FREETYPE_MINOR == 8 && FREETYPE_PATCH >= 1))))
+	return texture_atlas_new(768, 512, 3, dpi_x, dpi_y);
+#else
+	return texture_atlas_new(768, 512, 1, dpi_x, dpi_y);
+#endif
+}
+
 /**
- * emebedded font
+ * glyph sets
  */
 
+static texture_font_t *
+load_into_set(struct rtb_font_manager *fm, struct rtb_font *font, int set)
+{
+	texture_font_t *txfont;
+
+	if (font->source.path)
+		txfont = texture_font_new_from_file(fm->sets[set].atlas,
+				font->size, font->source.path);
+	else
+		txfont = texture_font_new_from_memory(fm->sets[set].atlas,
+				font->size, font->source.base, font->source.size);
+
+	if (!txfont)
+		return NULL;
+
+	init_font(txfont, fm->cache_glyphs);
+	font->set_txfonts[set] = txfont;
+	return txfont;
+}
+
+static void
+free_glyph_set(struct rtb_font_manager *fm, int set)
+{
+	struct rtb_font *font;
+
+	TAILQ_FOREACH(font, &fm->managed_fonts, manager_entry) {
+		if (!font->set_txfonts[set])
+			continue;
+
+		texture_font_delete(font->set_txfonts[set]);
+		font->set_txfonts[set] = NULL;
+	}
+
+	if (fm->sets[set].atlas)
+		texture_atlas_delete(fm->sets[set].atlas);
+
+	fm->sets[set].atlas = NULL;
+}
+
+static int
+find_glyph_set(struct rtb_font_manager *fm, int dpi_x, int dpi_y)
+{
+	int i;
+
+	for (i = 0; i < RTB_FONT_MANAGER_GLYPH_SETS; i++)
+		if (fm->sets[i].atlas
+				&& fm->sets[i].dpi_x == dpi_x
+				&& fm->sets[i].dpi_y == dpi_y)
+			return i;
+
+	return -1;
+}
+
+/* returns an empty slot, evicting the least recently used glyph set if
+ * there isn't one. the current set is never evicted. */
+static int
+claim_glyph_set(struct rtb_font_manager *fm)
+{
+	int i, victim = -1;
+
+	for (i = 0; i < RTB_FONT_MANAGER_GLYPH_SETS; i++) {
+		if (i == fm->current_set)
+			continue;
+
+		if (!fm->sets[i].atlas)
+			return i;
+
+		if (victim < 0 || fm->sets[i].last_used < fm->sets[victim].last_used)
+			victim = i;
+	}
+
+	free_glyph_set(fm, victim);
+	return victim;
+}
+
 int
-rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
-		struct rtb_font *font, int pt_size, const void *base, size_t size)
+rtb_font_manager_set_dpi(struct rtb_font_manager *fm, int dpi_x, int dpi_y)
 {
-	font->txfont =
-		texture_font_new_from_memory(fm->atlas, pt_size, base, size);
+	struct rtb_font *font;
+	int set;
 
-	if (!font->txfont)
-		return -1;
+	set = find_glyph_set(fm, dpi_x, dpi_y);
+
+	if (set < 0) {
+		set = claim_glyph_set(fm);
+
+		fm->sets[set].atlas = new_atlas(dpi_x, dpi_y);
+		if (!fm->sets[set].atlas)
+			return -1;
+
+		fm->sets[set].dpi_x = dpi_x;
+		fm->sets[set].dpi_y = dpi_y;
+	}
+
+	/* rasterize everything before switching over so that running out of
+	 * memory halfway through leaves the current set untouched. */
+	TAILQ_FOREACH(font, &fm->managed_fonts, manager_entry)
+		if (!font->set_txfonts[set] && !load_into_set(fm, font, set))
+			goto err_load;
+
+	TAILQ_FOREACH(font, &fm->managed_fonts, manager_entry)
+		font->txfont = font->set_txfonts[set];
+
+	fm->current_set = set;
+	fm->atlas = fm->sets[set].atlas;
+	fm->sets[set].last_used = ++fm->set_clock;
+
+	return 0;
+
+err_load:
+	ERR("couldn't rasterize fonts at %dx%d dpi\n", dpi_x, dpi_y);
+
+	if (set != fm->current_set)
+		free_glyph_set(fm, set);
+
+	return -1;
+}
+
+/**
+ * managed fonts
+ */
+
+/* fills in everything but the font's source, rasterizes it into the
+ * current glyph set and puts it on the managed list, so that it gets
+ * rasterized into every other glyph set too. */
+static int
+manage_font(struct rtb_font_manager *fm, struct rtb_font *font, int pt_size)
+{
+	memset(font->set_txfonts, 0, sizeof(font->set_txfonts));
 
 	font->size = pt_size;
 	font->fm   = fm;
 
-	init_font(font, fm->cache_glyphs);
+	font->txfont = load_into_set(fm, font, fm->current_set);
+	if (!font->txfont)
+		return -1;
+
 	TAILQ_INSERT_TAIL(&fm->managed_fonts, font, manager_entry);
 	return 0;
 }
 
-void
-rtb_font_manager_free_embedded_font(struct rtb_font *font)
+static void
+unmanage_font(struct rtb_font *font)
 {
+	int i;
+
 	TAILQ_REMOVE(&font->fm->managed_fonts, font, manager_entry);
-	texture_font_delete(font->txfont);
+
+	for (i = 0; i < RTB_FONT_MANAGER_GLYPH_SETS; i++)
+		if (font->set_txfonts[i])
+			texture_font_delete(font->set_txfonts[i]);
+
+	memset(font->set_txfonts, 0, sizeof(font->set_txfonts));
+	font->txfont = NULL;
 
 	font->manager_entry.tqe_next = NULL;
 	font->manager_entry.tqe_prev = NULL;
 }
 
+/**
+ * emebedded font
+ */
+
+int
+rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
+		struct rtb_font *font, int pt_size, const void *base, size_t size)
+{
+	font->source.path = NULL;
+	font->source.base = base;
+	font->source.size = size;
+
+	return manage_font(fm, font, pt_size);
+}
+
+void
+rtb_font_manager_free_embedded_font(struct rtb_font *font)
+{
+	unmanage_font(font);
+}
+
 /**
  * external font
  */
@@ -109,25 +271,32 @@ int
 rtb_font_manager_load_external_font(struct rtb_font_manager *fm,
 		struct rtb_external_font *font, int pt_size, const char *path)
 {
-	font->txfont = texture_font_new_from_file(fm->atlas, pt_size, path);
-	if (!font->txfont) {
+	if (!(font->path = strdup(path)))
+		return -1;
+
+	font->source.path = font->path;
+	font->source.base = NULL;
+	font->source.size = 0;
+
+	if (manage_font(fm, RTB_FONT(font), pt_size)) {
 		ERR("couldn't load font \"%s\"\n", path);
+
+		free(font->path);
+		font->path = NULL;
 		return -1;
 	}
 
-	font->path = strdup(path);
-	font->size = pt_size;
-	font->fm   = fm;
-
-	init_font(RTB_FONT(font), fm->cache_glyphs);
 	return 0;
 }
 
 void
 rtb_font_manager_free_external_font(struct rtb_external_font *font)
 {
+	unmanage_font(RTB_FONT(font));
+
 	free(font->path);
-	texture_font_delete(font->txfont);
+	font->path = NULL;
+	font->source.path = NULL;
 }
 
 int
@@ -151,15 +320,25 @@ rtb_font_manager_init(struct rtb_font_manager *fm, int dpi_x, int dpi_y)
 
 	fm->cache_glyphs = NULL;
 
-#if defined(FT_CONFIG_OPTION_SUBPIXEL_RENDERING) || (FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && (FREETYPE_MINOR > 8 || (FREETYPE_MINOR == 8 && FREETYPE_PATCH >= 1))))
-	fm->atlas = texture_atlas_new(768, 512, 3, dpi_x, dpi_y);
-#else
-	fm->atlas = texture_atlas_new(768, 512, 1, dpi_x, dpi_y);
-#endif
+	memset(fm->sets, 0, sizeof(fm->sets));
+
+	fm->current_set = 0;
+	fm->set_clock = 1;
+
+	fm->sets[0].dpi_x = dpi_x;
+	fm->sets[0].dpi_y = dpi_y;
+	fm->sets[0].last_used = fm->set_clock;
+	fm->sets[0].atlas = fm->atlas = new_atlas(dpi_x, dpi_y);
+
+	if (!fm->atlas)
+		goto err_atlas;
 
 	TAILQ_INIT(&fm->managed_fonts);
+	TAILQ_INIT(&fm->text_objects);
 	return 0;
 
+err_atlas:
+	rtb_shader_free(RTB_SHADER(&fm->shader));
 err_shader:
 	return -1;
 }
@@ -167,13 +346,13 @@ err_shader:
 void
 rtb_font_manager_fini(struct rtb_font_manager *fm)
 {
-	struct rtb_font *font;
+	int i;
 
-	TAILQ_FOREACH(font, &fm->managed_fonts, manager_entry)
-		/* FIXME: free path of external font? */
-		texture_font_delete(font->txfont);
+	/* FIXME: free path of external font? */
+	for (i = 0; i < RTB_FONT_MANAGER_GLYPH_SETS; i++)
+		free_glyph_set(fm, i);
 
-	texture_atlas_delete(fm->atlas);
+	fm->atlas = NULL;
 
 	rtb_shader_free(RTB_SHADER(&fm->shader));
 }
@@ -25,6 +25,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <rutabaga/rutabaga.h>
 #include <rutabaga/element.h>
@@ -40,6 +41,7 @@
 #include "freetype-gl/vertex-buffer.h"
 
 #include "rtb_private/utf8.h"
+#include "rtb_private/slab.h"
 
 struct text_vertex {
 	float x, y;
@@ -88,45 +90,49 @@ quantize(float x, float modulo, float modulo_recip, float *remainder)
 	return floored * modulo;
 }
 
-int
-rtb_text_object_update(struct rtb_text_object *self,
-		struct rtb_font *rfont, struct rtb_window *win,
-		const rtb_utf8_t *text, float line_height_multiplier)
+/**
+ * layout
+ */
+
+static int
+reserve_codepoints(struct rtb_text_object *self, size_t count)
 {
-	float x, y, line_height, x0, y0, x1, y1, max_w, scale_x_recip;
-	struct rtb_point scale = win->scale_recip;
-	rtb_utf32_t codepoint, prev_codepoint;
-	uint32_t state, prev_state;
-	texture_font_t *font;
-	unsigned lines;
+	rtb_utf32_t *codepoints;
+	size_t capacity;
 
-	if (!rfont || !text)
-		return -1;
+	if (count <= self->layout.capacity)
+		return 0;
 
-	font = rfont->txfont;
-	self->font = rfont;
-	scale_x_recip = win->scale.x;
+	capacity = self->layout.capacity ? self->layout.capacity : 16;
+	while (capacity < count)
+		capacity *= 2;
 
-	vertex_buffer_clear(self->vertices);
+	codepoints = realloc(self->layout.codepoints,
+			capacity * sizeof(*codepoints));
 
-	line_height = (font->height * line_height_multiplier) * scale.y;
+	if (!codepoints)
+		return -1;
 
-	x  = 0.f;
-	x1 = 0.f;
-	y  = ceilf(line_height / 2.f)
-		- (font->descender * scale.y)
-		+ 1.f;
+	self->layout.codepoints = codepoints;
+	self->layout.capacity = capacity;
+	return 0;
+}
 
-	max_w = 0.f;
-	lines = 1;
+static int
+decode(struct rtb_text_object *self, const rtb_utf8_t *text)
+{
+	rtb_utf32_t codepoint;
+	uint32_t state, prev_state;
+	size_t length;
+
+	/* a utf-8 string never decodes to more codepoints than it has bytes */
+	if (reserve_codepoints(self, strlen(text)))
+		return -1;
 
 	state = prev_state = UTF8_ACCEPT;
-	prev_codepoint = 0;
+	length = 0;
 
 	for (; *text; prev_state = state, text++) {
-		texture_glyph_t *glyph;
-		float s0, t0, s1, t1, x0_shift, x1_shift;
-
 		switch(u8dec(&state, &codepoint, *text)) {
 		case UTF8_ACCEPT:
 			break;
@@ -143,6 +149,50 @@ rtb_text_object_update(struct rtb_text_object *self,
 			continue;
 		}
 
+		self->layout.codepoints[length++] = codepoint;
+	}
+
+	self->layout.length = length;
+	return 0;
+}
+
+/* turns the decoded codepoints into vertices using the metrics of the
+ * font manager's current glyph set and the window's current scale. */
+static void
+project(struct rtb_text_object *self, struct rtb_window *win)
+{
+	float x, y, line_height, x0, y0, x1, y1, max_w, scale_x_recip;
+	struct rtb_point scale = win->scale_recip;
+	rtb_utf32_t codepoint, prev_codepoint;
+	texture_font_t *font;
+	unsigned lines;
+	size_t i;
+
+	font = self->font->txfont;
+	scale_x_recip = win->scale.x;
+
+	vertex_buffer_clear(self->vertices);
+
+	line_height = (font->height * self->layout.line_height_multiplier)
+		* scale.y;
+
+	x  = 0.f;
+	x1 = 0.f;
+	y  = ceilf(line_height / 2.f)
+		- (font->descender * scale.y)
+		+ 1.f;
+
+	max_w = 0.f;
+	lines = 1;
+
+	prev_codepoint = 0;
+
+	for (i = 0; i < self->layout.length; i++) {
+		texture_glyph_t *glyph;
+		float s0, t0, s1, t1, x0_shift, x1_shift;
+
+		codepoint = self->layout.codepoints[i];
+
 		if (codepoint == '\n') {
 			lines++;
 
@@ -192,7 +242,34 @@ rtb_text_object_update(struct rtb_text_object *self,
 	vertex_buffer_upload(self->vertices);
 	self->h = line_height * lines;
 	self->w = roundf((x > max_w) ? x : max_w);
+}
+
+int
+rtb_text_object_update(struct rtb_text_object *self,
+		struct rtb_font *rfont, struct rtb_window *win,
+		const rtb_utf8_t *text, float line_height_multiplier)
+{
+	if (!rfont || !text)
+		return -1;
+
+	if (decode(self, text))
+		return -1;
+
+	self->font = rfont;
+	self->layout.line_height_multiplier = line_height_multiplier;
 
+	project(self, win);
+	return 0;
+}
+
+int
+rtb_text_object_reproject(struct rtb_text_object *self,
+		struct rtb_window *win)
+{
+	if (!self->font)
+		return -1;
+
+	project(self, win);
 	return 0;
 }
 
@@ -232,17 +309,21 @@ rtb_text_object_render(struct rtb_text_object *self,
 struct rtb_text_object *
 rtb_text_object_new(struct rtb_font_manager *fm)
 {
-	struct rtb_text_object *self = calloc(1, sizeof(*self));
+	struct rtb_text_object *self = slab_allocator.calloc(1, sizeof(*self));
 
 	self->fm = fm;
 	self->vertices = vertex_buffer_new("vertex:2f,tex_coord:2f,subpixel_shift:1f");
 
+	TAILQ_INSERT_TAIL(&fm->text_objects, self, manager_entry);
 	return self;
 }
 
 void
 rtb_text_object_free(struct rtb_text_object *self)
 {
+	TAILQ_REMOVE(&self->fm->text_objects, self, manager_entry);
+
 	vertex_buffer_delete(self->vertices);
-	free(self);
+	free(self->layout.codepoints);
+	slab_allocator.free(self);
 }
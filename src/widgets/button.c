@@ -37,12 +37,16 @@
 #include <rutabaga/keyboard.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 #include <rutabaga/widgets/button.h>
 
 #define SELF_FROM(elem) \
 	struct rtb_button *self = RTB_ELEMENT_AS(elem, rtb_button)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation button_impl;
+static struct rtb_type_atom_descriptor button_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.button");
 
 /**
  * event handlers
@@ -126,8 +130,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.button");
+	self->type = rtb_type_register(&button_type, self->type);
 
 	self->outer_pad.x = self->label.outer_pad.x;
 	self->outer_pad.y = self->label.outer_pad.y;
@@ -157,11 +160,14 @@ rtb_button_init(struct rtb_button *self)
 	self->outer_pad.x =
 		self->outer_pad.y = 0.f;
 
-	self->on_event  = on_event;
-	self->attached  = attached;
+	button_impl = super;
+	button_impl.on_event = on_event;
+	button_impl.attached = attached;
+	button_impl.reflow   = reflow;
+	self->impl = &button_impl;
+
 	self->layout_cb = rtb_layout_hpack_center;
 	self->size_cb   = rtb_size_hfit_children;
-	self->reflow    = reflow;
 
 	return 0;
 }
@@ -173,11 +179,18 @@ rtb_button_fini(struct rtb_button *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_button_free(RTB_ELEMENT_AS(elem, rtb_button));
+}
+
 struct rtb_button *
 rtb_button_new(const rtb_utf8_t *label)
 {
-	struct rtb_button *self = calloc(1, sizeof(*self));
+	struct rtb_button *self = slab_allocator.calloc(1, sizeof(*self));
 	rtb_button_init(self);
+	self->release = release;
 
 	if (label)
 		rtb_button_set_label(self, label);
@@ -189,5 +202,5 @@ void
 rtb_button_free(struct rtb_button *self)
 {
 	rtb_button_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
@@ -41,6 +41,7 @@
 #include <rutabaga/widgets/knob.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 
 #define SELF_FROM(elem) \
 	struct rtb_knob *self = RTB_ELEMENT_AS(elem, rtb_knob)
@@ -50,6 +51,9 @@
 #define DEGREE_RANGE (MAX_DEGREES - MIN_DEGREES)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation knob_impl;
+static struct rtb_type_atom_descriptor knob_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.knob");
 
 /**
  * drawing
@@ -88,8 +92,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.knob");
+	self->type = rtb_type_register(&knob_type, self->type);
 
 	set_value_hook(elem, 1);
 }
@@ -103,7 +106,7 @@ restyle(struct rtb_element *elem)
 	super.restyle(elem);
 
 	prop = rtb_style_query_prop(elem,
-			"-rtb-knob-rotor", RTB_STYLE_PROP_TEXTURE, 0);
+			RTB_PROP_KNOB_ROTOR, RTB_STYLE_PROP_TEXTURE, 0);
 	if (prop &&
 			!rtb_stylequad_set_background_image(&self->rotor, &prop->texture))
 		rtb_elem_mark_dirty(elem);
@@ -132,10 +135,12 @@ rtb_knob_init(struct rtb_knob *self)
 	if (RTB_SUBCLASS(RTB_VALUE_ELEMENT(self), rtb_value_element_init, &super))
 		return -1;
 
-	self->draw     = draw;
-	self->attached = attached;
-	self->restyle  = restyle;
-	self->reflow   = reflow;
+	knob_impl = super;
+	knob_impl.draw     = draw;
+	knob_impl.attached = attached;
+	knob_impl.restyle  = restyle;
+	knob_impl.reflow   = reflow;
+	self->impl = &knob_impl;
 
 	self->set_value_hook = set_value_hook;
 
@@ -151,11 +156,18 @@ rtb_knob_fini(struct rtb_knob *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_knob_free(RTB_ELEMENT_AS(elem, rtb_knob));
+}
+
 struct rtb_knob *
 rtb_knob_new()
 {
-	struct rtb_knob *self = calloc(1, sizeof(struct rtb_knob));
+	struct rtb_knob *self = slab_allocator.calloc(1, sizeof(struct rtb_knob));
 	rtb_knob_init(self);
+	self->release = release;
 	return self;
 }
 
@@ -163,5 +175,5 @@ void
 rtb_knob_free(struct rtb_knob *self)
 {
 	rtb_knob_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
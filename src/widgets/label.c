@@ -36,10 +36,15 @@
 
 #include <rutabaga/widgets/label.h>
 
+#include "rtb_private/slab.h"
+
 #define SELF_FROM(elem) \
 	struct rtb_label *self = RTB_ELEMENT_AS(elem, rtb_label)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation label_impl;
+static struct rtb_type_atom_descriptor label_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.label");
 
 static void
 draw(struct rtb_element *elem)
@@ -57,8 +62,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.label");
+	self->type = rtb_type_register(&label_type, self->type);
 
 	self->tobj = rtb_text_object_new(&window->font_manager);
 }
@@ -99,7 +103,7 @@ restyle(struct rtb_element *elem)
 	super.restyle(elem);
 
 	prop = rtb_style_query_prop_in_tree(self->parent,
-			"font", RTB_STYLE_PROP_FONT, 0);
+			RTB_PROP_FONT, RTB_STYLE_PROP_FONT, 0);
 
 	assert(prop);
 
@@ -115,7 +119,7 @@ restyle(struct rtb_element *elem)
 	}
 
 	prop = rtb_style_query_prop_in_tree(self->parent,
-			"color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_COLOR, RTB_STYLE_PROP_COLOR, 1);
 	self->color = &prop->color;
 }
 
@@ -155,12 +159,14 @@ rtb_label_init(struct rtb_label *self)
 	if (RTB_SUBCLASS(RTB_ELEMENT(self), rtb_elem_init, &super))
 		return -1;
 
-	self->impl = super;
-	self->impl.draw     = draw;
-	self->impl.attached = attached;
-	self->impl.detached = detached;
-	self->impl.size_cb  = size;
-	self->impl.restyle  = restyle;
+	label_impl = super;
+	label_impl.draw     = draw;
+	label_impl.attached = attached;
+	label_impl.detached = detached;
+	label_impl.restyle  = restyle;
+	self->impl = &label_impl;
+
+	self->size_cb = size;
 
 	self->text = NULL;
 	self->tobj = NULL;
@@ -183,11 +189,18 @@ rtb_label_fini(struct rtb_label *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_label_free(RTB_ELEMENT_AS(elem, rtb_label));
+}
+
 struct rtb_label *
 rtb_label_new(const rtb_utf8_t *text)
 {
-	struct rtb_label *self = calloc(1, sizeof(*self));
+	struct rtb_label *self = slab_allocator.calloc(1, sizeof(*self));
 	rtb_label_init(self);
+	self->release = release;
 
 	if (text)
 		self->text = strdup(text);
@@ -199,5 +212,5 @@ void
 rtb_label_free(struct rtb_label *self)
 {
 	rtb_label_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
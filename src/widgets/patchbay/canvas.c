@@ -44,6 +44,7 @@
 #include <rutabaga/widgets/patchbay.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 
 #include "shaders/patchbay-canvas.glsl.h"
 
@@ -54,6 +55,9 @@
 #define DISCONNECT_COLOR	RTB_RGB(0x69181B)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation patchbay_impl;
+static struct rtb_type_atom_descriptor patchbay_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.patchbay");
 
 /**
  * custom openGL stuff
@@ -168,7 +172,7 @@ draw_bg(struct rtb_patchbay *self)
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-image", RTB_STYLE_PROP_TEXTURE, 1);
+			RTB_PROP_BACKGROUND_IMAGE, RTB_STYLE_PROP_TEXTURE, 1);
 
 	glBindTexture(GL_TEXTURE_2D, self->bg_texture);
 	glUniform1i(shader.uniform.texture, 0);
@@ -178,7 +182,7 @@ draw_bg(struct rtb_patchbay *self)
 			roundf(self->texture_offset.y));
 
 	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glUniform4f(shader.uniform.front_color,
 			prop->color.r,
@@ -187,7 +191,7 @@ draw_bg(struct rtb_patchbay *self)
 			prop->color.a);
 
 	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glUniform4f(shader.uniform.back_color,
 			prop->color.r,
@@ -395,8 +399,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.patchbay");
+	self->type = rtb_type_register(&patchbay_type, self->type);
 
 	cache_to_vbo(self);
 }
@@ -412,7 +415,7 @@ restyle(struct rtb_element *elem)
 	super.restyle(elem);
 
 	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-image", RTB_STYLE_PROP_TEXTURE, 0);
+			RTB_PROP_BACKGROUND_IMAGE, RTB_STYLE_PROP_TEXTURE, 0);
 
 	if (prop)
 		load_tile(&prop->texture, self->bg_texture);
@@ -443,12 +446,18 @@ rtb_patchbay_init(struct rtb_patchbay *self)
 
 	TAILQ_INIT(&self->patches);
 
-	self->draw      = draw;
-	self->on_event  = on_event;
-	self->attached  = attached;
+	patchbay_impl = super;
+	patchbay_impl.draw      = draw;
+	patchbay_impl.on_event  = on_event;
+	patchbay_impl.attached  = attached;
+	patchbay_impl.reflow    = reflow;
+	patchbay_impl.restyle   = restyle;
+	self->impl = &patchbay_impl;
+
 	self->layout_cb = layout;
-	self->reflow    = reflow;
-	self->restyle   = restyle;
+
+	/* nodes are placed by hand, so nothing inside can resize us */
+	self->flags |= RTB_ELEM_LAYOUT_ROOT;
 
 	init_shaders();
 
@@ -470,16 +479,24 @@ rtb_patchbay_fini(struct rtb_patchbay *self)
 	rtb_surface_fini(RTB_SURFACE(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_patchbay_free(RTB_ELEMENT_AS(elem, rtb_patchbay));
+}
+
 struct rtb_patchbay *
 rtb_patchbay_new()
 {
-	struct rtb_patchbay *self = calloc(1, sizeof(*self));
+	struct rtb_patchbay *self = slab_allocator.calloc(1, sizeof(*self));
 
 	if (rtb_patchbay_init(self)) {
-		free(self);
+		slab_allocator.free(self);
 		return NULL;
 	}
 
+	self->release = release;
+
 	return self;
 }
 
@@ -487,5 +504,5 @@ void
 rtb_patchbay_free(struct rtb_patchbay *self)
 {
 	rtb_patchbay_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
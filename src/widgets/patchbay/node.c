@@ -33,6 +33,7 @@
 #include <rutabaga/widgets/patchbay.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 
 #define SELF_FROM(elem) \
 	struct rtb_patchbay_node *self = RTB_ELEMENT_AS(elem, rtb_patchbay_node)
@@ -40,6 +41,9 @@
 #define LABEL_PADDING		15.f
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation node_impl;
+static struct rtb_type_atom_descriptor node_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.patchbay.node");
 
 /**
  * element implementation
@@ -88,8 +92,7 @@ attached(struct rtb_element *elem,
 	self->patchbay = (struct rtb_patchbay *) parent;
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.patchbay.node");
+	self->type = rtb_type_register(&node_type, self->type);
 }
 
 static void
@@ -122,8 +125,11 @@ rtb_patchbay_node_init(struct rtb_patchbay_node *self)
 	if (RTB_SUBCLASS(RTB_ELEMENT(self), rtb_elem_init, &super))
 		return -1;
 
-	self->on_event  = on_event;
-	self->attached  = attached;
+	node_impl = super;
+	node_impl.on_event = on_event;
+	node_impl.attached = attached;
+	self->impl = &node_impl;
+
 	self->size_cb   = size;
 	self->layout_cb = rtb_layout_vpack_top;
 
@@ -194,11 +200,18 @@ rtb_patchbay_node_fini(struct rtb_patchbay_node *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_patchbay_node_free(RTB_ELEMENT_AS(elem, rtb_patchbay_node));
+}
+
 struct rtb_patchbay_node *
 rtb_patchbay_node_new(struct rtb_patchbay *parent, const rtb_utf8_t *name)
 {
-	struct rtb_patchbay_node *self = calloc(1, sizeof(*self));
+	struct rtb_patchbay_node *self = slab_allocator.calloc(1, sizeof(*self));
 	rtb_patchbay_node_init(self);
+	self->release = release;
 
 	if (name)
 		rtb_patchbay_node_set_name(self, name);
@@ -210,5 +223,5 @@ void
 rtb_patchbay_node_free(struct rtb_patchbay_node *self)
 {
 	rtb_patchbay_node_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
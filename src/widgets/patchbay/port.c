@@ -36,6 +36,9 @@
 #include "rtb_private/util.h"
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation port_impl;
+static struct rtb_type_atom_descriptor port_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.patchbay.port");
 
 #define SELF_FROM(elem) \
 	struct rtb_patchbay_port *self = RTB_ELEMENT_AS(elem, rtb_patchbay_port)
@@ -215,8 +218,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(RTB_ELEMENT(self), parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.patchbay.port");
+	self->type = rtb_type_register(&port_type, self->type);
 }
 
 static int
@@ -362,8 +364,11 @@ rtb_patchbay_port_init(struct rtb_patchbay_port *self,
 	self->port_type  = type;
 	self->node       = node;
 
-	self->attached  = attached;
-	self->on_event  = on_event;
+	port_impl = super;
+	port_impl.attached = attached;
+	port_impl.on_event = on_event;
+	self->impl = &port_impl;
+
 	self->size_cb   = rtb_size_hfill;
 	self->layout_cb = rtb_layout_vpack_top;
 
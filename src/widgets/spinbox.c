@@ -39,11 +39,15 @@
 #include <rutabaga/widgets/spinbox.h>
 
 #include "rtb_private/util.h"
+#include "rtb_private/slab.h"
 
 #define SELF_FROM(elem) \
 	struct rtb_spinbox *self = RTB_ELEMENT_AS(elem, rtb_spinbox)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation spinbox_impl;
+static struct rtb_type_atom_descriptor spinbox_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.spinbox");
 
 /**
  * internal API hooks
@@ -66,8 +70,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.spinbox");
+	self->type = rtb_type_register(&spinbox_type, self->type);
 
 	set_value_hook(elem, 1);
 }
@@ -82,7 +85,9 @@ rtb_spinbox_init(struct rtb_spinbox *self)
 	if (RTB_SUBCLASS(RTB_VALUE_ELEMENT(self), rtb_value_element_init, &super))
 		return -1;
 
-	self->attached = attached;
+	spinbox_impl = super;
+	spinbox_impl.attached = attached;
+	self->impl = &spinbox_impl;
 
 	self->size_cb   = rtb_size_hfit_children;
 	self->layout_cb = rtb_layout_hpack_center;
@@ -106,11 +111,19 @@ rtb_spinbox_fini(struct rtb_spinbox *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_spinbox_free(RTB_ELEMENT_AS(elem, rtb_spinbox));
+}
+
 struct rtb_spinbox *
 rtb_spinbox_new()
 {
-	struct rtb_spinbox *self = calloc(1, sizeof(struct rtb_spinbox));
+	struct rtb_spinbox *self =
+		slab_allocator.calloc(1, sizeof(struct rtb_spinbox));
 	rtb_spinbox_init(self);
+	self->release = release;
 	return self;
 }
 
@@ -118,5 +131,5 @@ void
 rtb_spinbox_free(struct rtb_spinbox *self)
 {
 	rtb_spinbox_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
@@ -37,6 +37,7 @@
 #include <rutabaga/widgets/text-input.h>
 
 #include "rtb_private/stdlib-allocator.h"
+#include "rtb_private/slab.h"
 #include "rtb_private/util.h"
 #include "rtb_private/utf8.h"
 
@@ -46,6 +47,9 @@
 #define UTF8_IS_CONTINUATION(byte) (((byte) & 0xC0) == 0x80)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation text_input_impl;
+static struct rtb_type_atom_descriptor text_input_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.widgets.text-input");
 
 /**
  * vbo wrangling
@@ -186,6 +190,10 @@ fix_cursor(struct rtb_text_input *self)
 {
 	struct rtb_rect glyph;
 
+	/* the cursor is placed using the label's geometry, and an edit
+	 * earlier in this frame may not have been laid out yet. */
+	rtb_window_flush_reflow(self->window);
+
 	if (self->cursor_position < 0)
 		self->cursor_position = 0;
 	else if (self->cursor_position > 0 &&
@@ -309,8 +317,7 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.widgets.text-input");
+	self->type = rtb_type_register(&text_input_type, self->type);
 }
 
 static void
@@ -395,11 +402,14 @@ rtb_text_input_init(struct rutabaga *rtb, struct rtb_text_input *self)
 	self->outer_pad.x =
 		self->outer_pad.y = 0.f;
 
-	self->draw      = draw;
-	self->on_event  = on_event;
-	self->attached  = attached;
-	self->reflow    = reflow;
-	self->restyle   = restyle;
+	text_input_impl = super;
+	text_input_impl.draw      = draw;
+	text_input_impl.on_event  = on_event;
+	text_input_impl.attached  = attached;
+	text_input_impl.reflow    = reflow;
+	text_input_impl.restyle   = restyle;
+	self->impl = &text_input_impl;
+
 	self->size_cb   = rtb_size_self;
 	self->layout_cb = layout;
 
@@ -423,11 +433,18 @@ rtb_text_input_fini(struct rtb_text_input *self)
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
 
+static void
+release(struct rtb_element *elem)
+{
+	rtb_text_input_free(RTB_ELEMENT_AS(elem, rtb_text_input));
+}
+
 struct rtb_text_input *
 rtb_text_input_new(struct rutabaga *rtb)
 {
-	struct rtb_text_input *self = calloc(1, sizeof(*self));
+	struct rtb_text_input *self = slab_allocator.calloc(1, sizeof(*self));
 	rtb_text_input_init(rtb, self);
+	self->release = release;
 
 	return self;
 }
@@ -436,5 +453,5 @@ void
 rtb_text_input_free(struct rtb_text_input *self)
 {
 	rtb_text_input_fini(self);
-	free(self);
+	slab_allocator.free(self);
 }
@@ -43,6 +43,7 @@
 	struct rtb_value_element *self = RTB_ELEMENT_AS(elem, rtb_value_element)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation value_impl;
 
 /* would be cool to have this be like a smoothed equation or smth */
 #define DELTA_VALUE_STEP_COARSE	.005f
@@ -426,8 +427,10 @@ rtb_value_element_init(struct rtb_value_element *self)
 	if (RTB_SUBCLASS(RTB_ELEMENT(self), rtb_elem_init, &super))
 		return -1;
 
-	self->attached = attached;
-	self->on_event = on_event;
+	value_impl = super;
+	value_impl.attached = attached;
+	value_impl.on_event = on_event;
+	self->impl = &value_impl;
 
 	self->granularity  =
 		self->value    =
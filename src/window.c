@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 
 #include <rutabaga/rutabaga.h>
@@ -35,6 +36,7 @@
 #include <rutabaga/container.h>
 #include <rutabaga/window.h>
 #include <rutabaga/font-manager.h>
+#include <rutabaga/text-object.h>
 #include <rutabaga/shader.h>
 #include <rutabaga/surface.h>
 #include <rutabaga/style.h>
@@ -42,6 +44,9 @@
 
 #include "rtb_private/util.h"
 #include "rtb_private/window_impl.h"
+#include "rtb_private/stdlib-allocator.h"
+#include "rtb_private/layout-pool.h"
+#include "rtb_private/geometry-store.h"
 
 #include "shaders/default.glsl.h"
 #include "shaders/surface.glsl.h"
@@ -52,6 +57,9 @@
 	struct rtb_window *self = RTB_ELEMENT_AS(elem, rtb_window)
 
 static struct rtb_element_implementation super;
+static struct rtb_element_implementation win_impl;
+static struct rtb_type_atom_descriptor window_type =
+	RTB_TYPE_DESCRIPTOR("net.illest.rutabaga.window");
 
 /**
  * index buffer objects
@@ -257,11 +265,10 @@ attached(struct rtb_element *elem,
 	SELF_FROM(elem);
 
 	super.attached(elem, parent, window);
-	self->type = rtb_type_ref(window, self->type,
-			"net.illest.rutabaga.window");
+	self->type = rtb_type_register(&window_type, self->type);
 
 	rtb_style_resolve_list(self, self->style_list);
-	self->restyle(RTB_ELEMENT(self));
+	self->impl->restyle(RTB_ELEMENT(self));
 }
 
 static void
@@ -271,6 +278,54 @@ mark_dirty(struct rtb_element *elem)
 	self->dirty = 1;
 }
 
+/**
+ * reflow
+ */
+
+static unsigned int
+elem_depth(struct rtb_element *elem)
+{
+	unsigned int depth = 0;
+
+	for (; elem->parent && elem->parent != elem; elem = elem->parent)
+		depth++;
+
+	return depth;
+}
+
+static int
+request_depth_cmp(const void *_a, const void *_b)
+{
+	const struct rtb_reflow_request *a = _a, *b = _b;
+	return (a->depth > b->depth) - (a->depth < b->depth);
+}
+
+static void
+run_reflow(struct rtb_element *elem, unsigned int which)
+{
+	struct rtb_element *instigator;
+
+	if (!(elem->reflow_pending & which))
+		return;
+
+	elem->reflow_pending &= ~which;
+
+	if (which == RTB_REFLOW_ROOTWARD) {
+		instigator = elem->reflow_instigator;
+		elem->reflow_instigator = NULL;
+
+		elem->impl->reflow(elem, instigator, RTB_DIRECTION_ROOTWARD);
+		return;
+	}
+
+	/* a window-wide reflow gets its geometry worked out on the layout
+	 * pool first, so the reflow pass only has the GL work left to do. */
+	if (elem == RTB_ELEMENT(elem->window) && elem->window->layout_pool)
+		rtb_layout_pool_lay_out(elem->window->layout_pool, elem);
+
+	elem->impl->reflow(elem, NULL, RTB_DIRECTION_LEAFWARD);
+}
+
 /**
  * public API
  */
@@ -301,7 +356,8 @@ rtb_window_draw(struct rtb_window *self, int force_redraw)
 	struct rtb_window_event ev;
 
 	if (self->state == RTB_STATE_UNATTACHED
-			|| self->visibility == RTB_FULLY_OBSCURED)
+			|| rtb_elem_visibility(RTB_ELEMENT(self))
+				== RTB_FULLY_OBSCURED)
 		return 0;
 
 	ev.type = RTB_FRAME_START;
@@ -309,13 +365,15 @@ rtb_window_draw(struct rtb_window *self, int force_redraw)
 	ev.window = self;
 	rtb_dispatch_raw(RTB_ELEMENT(self), RTB_EVENT(&ev));
 
+	rtb_window_flush_reflow(self);
+
 	if (!self->dirty || force_redraw)
 		return 0;
 
 	glViewport(0, 0, self->phy_size.w, self->phy_size.h);
 
 	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+			RTB_PROP_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glEnable(GL_DITHER);
 	glEnable(GL_BLEND);
@@ -329,7 +387,7 @@ rtb_window_draw(struct rtb_window *self, int force_redraw)
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	rtb_render_push(RTB_ELEMENT(self));
-	self->draw(RTB_ELEMENT(self));
+	self->impl->draw(RTB_ELEMENT(self));
 	rtb_render_pop(RTB_ELEMENT(self));
 
 	self->dirty = 0;
@@ -340,6 +398,60 @@ rtb_window_draw(struct rtb_window *self, int force_redraw)
 	return 1;
 }
 
+void
+rtb_window_flush_reflow(struct rtb_window *self)
+{
+	struct rtb_reflow_request *queue, req;
+	struct rtb_element *elem;
+	size_t i, batch;
+
+	if (!self->finished_initialising || self->flushing_reflow)
+		return;
+
+	self->flushing_reflow = 1;
+
+	/* anything queued while a batch runs goes into the next one */
+	while ((batch = self->reflow_queue.size)) {
+		queue = self->reflow_queue.data;
+
+		for (i = 0; i < batch; i++)
+			if (queue[i].elem)
+				queue[i].depth = elem_depth(queue[i].elem);
+
+		qsort(queue, batch, sizeof(*queue), request_depth_cmp);
+
+		/* rootward reflows go deepest first, so one that resizes an
+		 * ancestor gets folded into the ancestor's own. leafward ones
+		 * then go shallowest first, so a subtree that's been laid out
+		 * from above isn't laid out again. */
+		for (i = batch; i-- > 0;)
+			if ((elem = self->reflow_queue.data[i].elem))
+				run_reflow(elem, RTB_REFLOW_ROOTWARD);
+
+		for (i = 0; i < batch; i++)
+			if ((elem = self->reflow_queue.data[i].elem))
+				run_reflow(elem, RTB_REFLOW_LEAFWARD);
+
+		for (i = 0; i < batch; i++) {
+			req = self->reflow_queue.data[i];
+
+			if (!req.elem)
+				continue;
+
+			/* asked for again while the batch ran */
+			if (req.elem->reflow_pending
+					& (RTB_REFLOW_LEAFWARD | RTB_REFLOW_ROOTWARD))
+				VECTOR_PUSH_BACK(&self->reflow_queue, &req);
+			else
+				req.elem->reflow_pending = 0;
+		}
+
+		VECTOR_ERASE_RANGE(&self->reflow_queue, 0, batch);
+	}
+
+	self->flushing_reflow = 0;
+}
+
 void
 rtb_window_reinit(struct rtb_window *self)
 {
@@ -354,11 +466,47 @@ rtb_window_reinit(struct rtb_window *self)
 
 	glScissor(0, 0, self->phy_size.w, self->phy_size.h);
 
+	if (!++self->measure_generation)
+		self->measure_generation = 1;
+
 	if (!self->window)
-		self->attached(elem, NULL, self);
+		self->impl->attached(elem, NULL, self);
 
 	self->finished_initialising = 1;
 	rtb_elem_trigger_reflow(elem, elem, RTB_DIRECTION_LEAFWARD);
+	rtb_window_flush_reflow(self);
+}
+
+int
+rtb_window_set_scale(struct rtb_window *self, struct rtb_point scale)
+{
+	struct rtb_text_object *tobj;
+	int dpi_x, dpi_y;
+
+	if (scale.x == self->scale.x && scale.y == self->scale.y)
+		return 0;
+
+	dpi_x = 96 * scale.x;
+	dpi_y = 96 * scale.y;
+
+	if (rtb_font_manager_set_dpi(&self->font_manager, dpi_x, dpi_y))
+		return -1;
+
+	self->scale = scale;
+	self->scale_recip.x = 1.f / scale.x;
+	self->scale_recip.y = 1.f / scale.y;
+
+	self->dpi.x = dpi_x;
+	self->dpi.y = dpi_y;
+
+	/* the glyph metrics changed underneath every text object, but the
+	 * text itself didn't. re-project in place rather than going through
+	 * restyle, then let one leafward reflow pick up the new sizes. */
+	TAILQ_FOREACH(tobj, &self->font_manager.text_objects, manager_entry)
+		rtb_text_object_reproject(tobj, self);
+
+	rtb_window_reinit(self);
+	return 0;
 }
 
 static int
@@ -406,6 +554,20 @@ rtb_window_open(struct rutabaga *r, const struct rtb_window_open_options *opt)
 	stdata = rtb_style_get_defaults();
 	self->style_list = stdata.style;
 	self->style_fonts = calloc(stdata.nfonts, sizeof(*self->style_fonts));
+	self->style_prop_names = stdata.prop_names;
+	self->style_nprops = stdata.nprops;
+	self->style_generation = 1;
+	self->style_cache_list = self->style_list;
+
+	VECTOR_INIT(&self->reflow_queue, &stdlib_allocator, 16);
+	self->measure_generation = 1;
+
+	/* NULL on a single core, in which case everything is laid out on
+	 * the main thread. */
+	self->layout_pool = rtb_layout_pool_new();
+
+	if (!(self->geometry = rtb_geometry_store_new()))
+		goto err_geometry;
 
 	if (shaders_init(self))
 		goto err_shaders;
@@ -419,9 +581,11 @@ rtb_window_open(struct rutabaga *r, const struct rtb_window_open_options *opt)
 
 	rtb_elem_set_layout(RTB_ELEMENT(self), rtb_layout_vpack_top);
 
-	self->on_event   = win_event;
-	self->mark_dirty = mark_dirty;
-	self->attached   = attached;
+	win_impl = super;
+	win_impl.on_event   = win_event;
+	win_impl.mark_dirty = mark_dirty;
+	win_impl.attached   = attached;
+	self->impl = &win_impl;
 
 	self->flags = RTB_ELEM_CLICK_FOCUS;
 
@@ -441,6 +605,13 @@ err_font:
 err_ibos:
 	shaders_fini(self);
 err_shaders:
+	rtb_geometry_store_free(self->geometry);
+err_geometry:
+	if (self->layout_pool)
+		rtb_layout_pool_free(self->layout_pool);
+
+	VECTOR_FREE(&self->reflow_queue);
+	free(self->style_fonts);
 err_surface_init:
 	window_impl_close(self);
 err_window_impl:
@@ -461,8 +632,16 @@ rtb_window_close(struct rtb_window *self)
 	shaders_fini(self);
 
 	free(self->style_fonts);
-	free(self->style_list);
+	rtb_style_free_list(self->style_list);
+	rtb_style_free_themes(self);
+	rtb_style_free_type_cache(self);
 
 	rtb_surface_fini(RTB_SURFACE(self));
+	VECTOR_FREE(&self->reflow_queue);
+
+	if (self->layout_pool)
+		rtb_layout_pool_free(self->layout_pool);
+
+	rtb_geometry_store_free(self->geometry);
 	window_impl_close(self);
 }
@@ -6,6 +6,7 @@ from waflib.Configure import conf
 
 from rutabaga_css import RutabagaStylesheet
 from rutabaga_css.asset import *
+from rutabaga_css.binary import RutabagaBinaryStylesheet
 
 from targa import *
 
@@ -14,7 +15,7 @@ def matches_extension(ext):
     return lambda i: splitext(i.name)[1] == ext
 
 def do_css2c(task):
-    var_name = "default_style"
+    var_name = task.env.RTB_STYLE_VAR_NAME
 
     stylesheet = task.inputs[0].rtb_stylesheet
 
@@ -25,7 +26,9 @@ def do_css2c(task):
         copyright + css2c_prelude
         + ("extern const struct rtb_style {var_name}[];\n"
            "extern const size_t {var_name}_size;\n"
-           "extern const size_t {var_name}_fonts;\n").format(var_name=var_name))
+           "extern const size_t {var_name}_fonts;\n"
+           "extern const char *const {var_name}_props[];\n"
+           "extern const size_t {var_name}_nprops;\n").format(var_name=var_name))
 
     output_file(".c").write(
         copyright + css2c_prelude
@@ -33,7 +36,29 @@ def do_css2c(task):
         + "const struct rtb_style {var_name}[] = ".format(var_name=var_name)
         + stylesheet.c_repr(var_name)
         + "\n\nconst size_t {var_name}_size = sizeof({var_name});".format(var_name=var_name)
-        + "\nconst size_t {var_name}_fonts = {fonts_used};".format(var_name=var_name, fonts_used = stylesheet.fonts_used))
+        + "\nconst size_t {var_name}_fonts = {fonts_used};".format(var_name=var_name, fonts_used = stylesheet.fonts_used)
+        + "\n\nconst char *const {var_name}_props[] = ".format(var_name=var_name)
+        + stylesheet.c_prop_names()
+        + "\nconst size_t {var_name}_nprops = {nprops};".format(var_name=var_name, nprops=len(stylesheet.prop_ids)))
+
+####
+# css2bin
+####
+
+def do_css2bin(task):
+    css_node = task.inputs[0]
+
+    def load_asset(path):
+        return css_node.parent.find_resource(path).read(flags="rb")
+
+    def decode_texture(data):
+        img = TargaImage()
+        img.from_bytes(data)
+        return (img.width, img.height, img.data)
+
+    binary = RutabagaBinaryStylesheet(css_node.rtb_bin_stylesheet,
+            load_asset, decode_texture)
+    task.outputs[0].write(binary.to_bytes(), flags="wb")
 
 ####
 # bin2c
@@ -161,8 +186,10 @@ def process_embedded_assets(bld, style_name, css):
     return sources
 
 @conf
-def rtb_style(bld, style_name, **kwargs):
-    """Parses a CSS file and generates build rules for embedding assets."""
+def rtb_style(bld, style_name, var_name="default_style", **kwargs):
+    """Parses a CSS file and generates build rules for embedding assets.
+    the generated style is exported as `var_name` (plus `var_name`_size,
+    _fonts, _props and _nprops)."""
 
     css_path = "{0}/style.css".format(style_name)
     css_node = bld.path.find_resource(css_path)
@@ -178,11 +205,18 @@ def rtb_style(bld, style_name, **kwargs):
         node = bld.path.find_resource(path)
         asset.path = node.abspath()
 
+    # the symbol name goes through the task's env so that changing it
+    # reruns css2c.
+    css2c_env = bld.env.derive()
+    css2c_env.RTB_STYLE_VAR_NAME = var_name
+
     bld(
         rule=do_css2c,
         source=css_node,
         target=["{0}/style.{1}".format(style_name, ext)
             for ext in ['c', 'h']],
+        env=css2c_env,
+        vars=["RTB_STYLE_VAR_NAME"],
         update_outputs=True)
 
     bld.stlib(
@@ -197,6 +231,25 @@ def rtb_style(bld, style_name, **kwargs):
         cflags=bld.env['CFLAGS_cshlib'],
         **kwargs)
 
+@conf
+def rtb_style_binary(bld, style_name, **kwargs):
+    """Compiles a CSS file into a binary stylesheet (style.rtbs) that can
+    be loaded at runtime with rtb_style_binary_load(). all embedded assets
+    go into the one file."""
+
+    css_path = "{0}/style.css".format(style_name)
+    css_node = bld.path.find_resource(css_path)
+
+    # parsed separately from rtb_style(), which rewrites asset paths
+    css_node.rtb_bin_stylesheet = RutabagaStylesheet(css_node, autoparse=True)
+
+    bld(
+        rule=do_css2bin,
+        source=css_node,
+        target="{0}/style.rtbs".format(style_name),
+        update_outputs=True,
+        **kwargs)
+
 ####
 # some blocks of text
 ####
@@ -0,0 +1,224 @@
+# rutabaga: an OpenGL widget toolkit
+# Copyright (c) 2013-2018 William Light.
+# All rights reserved.
+#
+# This is free and unencumbered software released into the public domain.
+#
+# Anyone is free to copy, modify, publish, use, compile, sell, or
+# distribute this software, either in source code form or as a compiled
+# binary, for any purpose, commercial or non-commercial, and by any
+# means.
+#
+# In jurisdictions that recognize copyright laws, the author or authors
+# of this software dedicate any and all copyright interest in the
+# software to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and
+# successors. We intend this dedication to be an overt act of
+# relinquishment in perpetuity of all present and future rights to this
+# software under copyright law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+# OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+# ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+#
+# For more information, please refer to <http://unlicense.org/>
+
+# the binary stylesheet format. see include/rutabaga/style-binary.h for
+# the layout -- the two have to agree.
+#
+# everything is little-endian and 4-byte aligned, and every reference is
+# an offset from the start of the file, so the runtime can mmap a
+# stylesheet and point straight into it.
+
+import struct
+
+from rutabaga_css.selector import name_hash
+from rutabaga_css.properties.rgba import RutabagaRGBAProperty
+from rutabaga_css.properties.float import RutabagaFloatProperty
+from rutabaga_css.properties.font import RutabagaFontProperty
+from rutabaga_css.properties.texture import \
+        RutabagaTextureProperty, RutabagaEmbeddedTexture
+
+all = ["RutabagaBinaryStylesheet"]
+
+MAGIC   = b"RTBS"
+VERSION = 1
+
+# rtb_style_prop_type_t
+PROP_COLOR   = 0
+PROP_FLOAT   = 1
+PROP_INT     = 2
+PROP_FONT    = 3
+PROP_TEXTURE = 4
+
+# rtb_asset_location_t
+ASSET_EXTERNAL = 0
+ASSET_EMBEDDED = 1
+
+# rtb_style_texture_flags_t
+texture_flags = {
+    'RTB_TEXTURE_VERTICAL_TILE':   0x1,
+    'RTB_TEXTURE_HORIZONTAL_TILE': 0x2,
+    'RTB_TEXTURE_FILL':            0x4}
+
+draw_states = ('normal', 'focus', 'hover', 'active')
+
+header_fmt   = "<4sIIIIIII"
+style_fmt    = "<II4I4I"
+compound_fmt = "<IIIIII"
+prop_fmt     = "<III32s"
+asset_fmt    = "<III"
+face_fmt     = "<II" + asset_fmt[1:]
+
+def align(n, to=4):
+    return (n + to - 1) & ~(to - 1)
+
+class RutabagaBinaryStylesheet(object):
+    """Serializes a parsed RutabagaStylesheet.
+
+    `load_asset` is called with each embedded asset's path and returns
+    its bytes. embedded textures are passed through `decode_texture`,
+    which returns (width, height, pixels)."""
+
+    def __init__(self, stylesheet, load_asset, decode_texture):
+        self.stylesheet = stylesheet
+        self.load_asset = load_asset
+        self.decode_texture = decode_texture
+
+    def reset(self):
+        self.buf = bytearray(struct.calcsize(header_fmt))
+        self.strings = {}
+        self.blobs = {}
+        self.faces = {}
+
+    def append(self, data):
+        off = len(self.buf)
+        self.buf += data
+        self.buf += b"\0" * (align(len(self.buf)) - len(self.buf))
+        return off
+
+    def string(self, s):
+        if s is None:
+            return 0
+
+        if s not in self.strings:
+            self.strings[s] = self.append(s.encode('utf-8') + b"\0")
+
+        return self.strings[s]
+
+    def blob(self, path, data):
+        if path not in self.blobs:
+            self.blobs[path] = (self.append(data), len(data))
+
+        return self.blobs[path]
+
+    def name(self, n):
+        if n is None:
+            return (0, 0)
+        return (self.string(n), name_hash(n))
+
+    def selector(self, sel):
+        if sel.is_plain():
+            return 0
+
+        compounds = []
+
+        # subject first, same as the C representation
+        for c in reversed(sel.compounds):
+            classes = 0
+            if c.classes:
+                classes = self.append(b"".join(
+                    [struct.pack("<II", *self.name(cls))
+                        for cls in c.classes]))
+
+            compounds.append(struct.pack(compound_fmt,
+                *(self.name(c.type) + self.name(c.id)
+                    + (len(c.classes), classes))))
+
+        return self.append(
+            struct.pack("<II", sel.specificity(), len(compounds))
+                + b"".join(compounds))
+
+    def texture(self, prop):
+        tex = prop.texture
+        flags = 0
+
+        for f in (prop.flags or '').split('|'):
+            f = f.strip()
+            if f:
+                flags |= texture_flags[f]
+
+        if isinstance(tex, RutabagaEmbeddedTexture):
+            w, h, pixels = self.decode_texture(
+                    self.load_asset(tex.path))
+            data, size = self.blob(tex.path, pixels)
+            asset = struct.pack(asset_fmt, ASSET_EMBEDDED, data, size)
+        else:
+            w, h = 0, 0
+            asset = struct.pack(asset_fmt,
+                    ASSET_EXTERNAL, self.string(tex.asset.path), 0)
+
+        return struct.pack("<IIII4I", self.append(asset), w, h, flags,
+                *[int(b) for b in prop.borders])
+
+    def face(self, prop):
+        asset = prop.font_ref
+
+        if asset.path not in self.faces:
+            data, size = self.blob(asset.path, self.load_asset(asset.path))
+            self.faces[asset.path] = self.append(struct.pack(face_fmt,
+                self.string(prop.family), self.string(prop.weight or "normal"),
+                ASSET_EMBEDDED, data, size))
+
+        return self.faces[asset.path]
+
+    def prop(self, name, prop):
+        if isinstance(prop, RutabagaRGBAProperty):
+            ptype, payload = PROP_COLOR, struct.pack("<4f", *prop.rgba)
+        elif isinstance(prop, RutabagaFloatProperty):
+            ptype, payload = PROP_FLOAT, struct.pack("<f", prop.value)
+        elif isinstance(prop, RutabagaTextureProperty):
+            ptype, payload = PROP_TEXTURE, self.texture(prop)
+        elif isinstance(prop, RutabagaFontProperty):
+            ptype, payload = PROP_FONT, struct.pack("<IifI",
+                    self.face(prop), int(prop.size), prop.gamma, prop.slot)
+        else:
+            raise TypeError("can't serialize {0!r}".format(prop))
+
+        return struct.pack(prop_fmt, self.string(name),
+                self.stylesheet.intern_prop(name), ptype, payload)
+
+    def style(self, style):
+        props = []
+        counts = []
+
+        for s in draw_states:
+            state = style.states[s]
+            counts.append(len(state.props))
+            records = [self.prop(n, state.props[n]) for n in state.props]
+            props.append(self.append(b"".join(records)) if records else 0)
+
+        return struct.pack(style_fmt, self.string(style.type),
+                self.selector(style.selector), *(props + counts))
+
+    def to_bytes(self):
+        self.reset()
+        css = self.stylesheet
+
+        styles = b"".join([self.style(css.styles[s]) for s in css.styles])
+        styles_off = self.append(styles)
+
+        prop_names = self.append(b"".join(
+            [struct.pack("<I", self.string(n)) for n in css.prop_ids]))
+
+        struct.pack_into(header_fmt, self.buf, 0,
+                MAGIC, VERSION, len(self.buf),
+                len(css.styles), styles_off,
+                len(css.prop_ids), prop_names,
+                css.fonts_used)
+
+        return bytes(self.buf)
@@ -0,0 +1,153 @@
+# rutabaga: an OpenGL widget toolkit
+# Copyright (c) 2013-2018 William Light.
+# All rights reserved.
+#
+# This is free and unencumbered software released into the public domain.
+#
+# Anyone is free to copy, modify, publish, use, compile, sell, or
+# distribute this software, either in source code form or as a compiled
+# binary, for any purpose, commercial or non-commercial, and by any
+# means.
+#
+# In jurisdictions that recognize copyright laws, the author or authors
+# of this software dedicate any and all copyright interest in the
+# software to the public domain. We make this dedication for the benefit
+# of the public at large and to the detriment of our heirs and
+# successors. We intend this dedication to be an overt act of
+# relinquishment in perpetuity of all present and future rights to this
+# software under copyright law.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+# OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+# ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+#
+# For more information, please refer to <http://unlicense.org/>
+
+all = [
+    "RutabagaCompound",
+    "RutabagaSelector",
+    "name_hash"]
+
+# every type, class and id name in a selector is emitted along with this
+# hash of it, which the runtime uses for its ancestor bloom filter. it has
+# to match rtb_style_hash() in src/style.c (32-bit FNV-1a).
+def name_hash(name):
+    h = 0x811c9dc5
+
+    for b in bytearray(name.encode('utf-8')):
+        h ^= b
+        h = (h * 0x01000193) & 0xffffffff
+
+    return h
+
+def c_name(name):
+    if name is None:
+        return "{NULL}"
+    return '{{"{0}", 0x{1:08X}u}}'.format(name, name_hash(name))
+
+class RutabagaCompound(object):
+    # one compound selector: `button.primary`, `#master`, `rtb|element`.
+    # a type of None matches any type.
+
+    def __init__(self):
+        self.type = None
+        self.id = None
+        self.classes = []
+        self.state = None
+
+    def is_plain(self):
+        return not (self.id or self.classes)
+
+    def key(self):
+        # bracketed so that e.g. `button.primary` can't collide with the
+        # plain `button::primary` type in the stylesheet's style dict.
+        return "{0}{1}{2}".format(
+            self.type or "*",
+            "".join(["[." + c + "]" for c in self.classes]),
+            "[#" + self.id + "]" if self.id else "")
+
+    c_repr_tpl = """\
+\t\t\t\t{{
+\t\t\t\t\t.type = {type},
+\t\t\t\t\t.id = {id},
+\t\t\t\t\t.classes = {classes}
+\t\t\t\t}}"""
+
+    c_classes_tpl = """\
+(const struct rtb_style_name []) {{
+{classes}
+\t\t\t\t\t}}"""
+
+    def c_repr(self):
+        if self.classes:
+            classes = self.c_classes_tpl.format(
+                classes=",\n".join(
+                    ["\t\t\t\t\t\t" + c_name(c) for c in self.classes]
+                        + ["\t\t\t\t\t\t{NULL}"]))
+        else:
+            classes = "NULL"
+
+        return self.c_repr_tpl.format(
+            type=c_name(self.type),
+            id=c_name(self.id),
+            classes=classes)
+
+class RutabagaSelector(object):
+    # `compounds` is in source order, so the subject is the last one and
+    # everything before it is an ancestor joined by a descendant combinator.
+
+    element_type = "net.illest.rutabaga.element"
+
+    def __init__(self, compounds):
+        self.compounds = compounds
+
+    @property
+    def subject(self):
+        return self.compounds[-1]
+
+    @property
+    def state(self):
+        return self.subject.state
+
+    def is_plain(self):
+        # plain type selectors go through the type-keyed fast path, the
+        # way every selector did before classes and ids existed.
+        return (len(self.compounds) == 1 and self.subject.is_plain()
+                and self.subject.type is not None)
+
+    def for_type(self):
+        return self.subject.type or self.element_type
+
+    def key(self):
+        if self.is_plain():
+            return self.subject.type
+        return " ".join([c.key() for c in self.compounds])
+
+    def specificity(self):
+        ids = sum([1 for c in self.compounds if c.id])
+        classes = sum([len(c.classes) for c in self.compounds])
+        types = sum([1 for c in self.compounds if c.type])
+
+        return (min(ids, 0xFF) << 16) | (min(classes, 0xFF) << 8) \
+                | min(types, 0xFF)
+
+    c_repr_tpl = """\
+&(const struct rtb_style_selector) {{
+\t\t\t.specificity = 0x{specificity:06X},
+\t\t\t.ncompounds = {ncompounds},
+\t\t\t.compounds = (const struct rtb_style_compound []) {{
+{compounds}
+\t\t\t}}
+\t\t}}"""
+
+    def c_repr(self):
+        # the runtime wants the subject first and then walks rootward.
+        return self.c_repr_tpl.format(
+            specificity=self.specificity(),
+            ncompounds=len(self.compounds),
+            compounds=",\n".join(
+                [c.c_repr() for c in reversed(self.compounds)]))
@@ -36,7 +36,7 @@ from rutabaga_css.properties.texture import *
 from rutabaga_css.properties.font import *
 from rutabaga_css.properties.float import *
 
-all = ['RutabagaStyle']
+all = ['RutabagaStyle', 'builtin_props']
 
 state_mapping = {
     'normal': 'RTB_DRAW_NORMAL',
@@ -66,6 +66,21 @@ prop_mapping = {
     '-rtb-knob-rotor': RutabagaTextureProperty,
 }
 
+# interned property ids. the order has to match rtb_style_prop_id_t in
+# include/rutabaga/style.h. properties not listed here are assigned ids
+# after these, in the order they first show up in the stylesheet.
+builtin_props = [
+    ('color',            'RTB_PROP_COLOR'),
+    ('background-color', 'RTB_PROP_BACKGROUND_COLOR'),
+    ('background-image', 'RTB_PROP_BACKGROUND_IMAGE'),
+    ('border-image',     'RTB_PROP_BORDER_IMAGE'),
+    ('border-color',     'RTB_PROP_BORDER_COLOR'),
+    ('min-width',        'RTB_PROP_MIN_WIDTH'),
+    ('min-height',       'RTB_PROP_MIN_HEIGHT'),
+    ('font',             'RTB_PROP_FONT'),
+    ('-rtb-knob-rotor',  'RTB_PROP_KNOB_ROTOR')
+]
+
 prop_suffix_mapping = {
     'color': RutabagaRGBAProperty,
     'image': RutabagaTextureProperty,
@@ -100,6 +115,8 @@ class RutabagaStyleState(object):
             self.parse_font_tokens(prop, tokens)
             return
 
+        self.stylesheet.intern_prop(prop)
+
         try:
             self.props[prop] = \
                     prop_mapping[prop](self.stylesheet, prop, tokens)
@@ -121,7 +138,8 @@ class RutabagaStyleState(object):
 
     c_prop_repr = '''\
 \t\t\t\t{{"{0}",
-{1}}}'''
+\t\t\t\t\t.id = {1},
+{2}}}'''
 
     def done_parsing(self):
         if self.font_descriptor['family']:
@@ -137,15 +155,17 @@ class RutabagaStyleState(object):
             state=state_mapping[state_name],
             properties=',\n\n'.join(
                 [self.c_prop_repr.format(
-                    prop_name, self.props[prop_name].c_repr())
+                    prop_name, self.stylesheet.c_prop_id(prop_name),
+                    self.props[prop_name].c_repr())
                     for prop_name in self.props]
                 + ['\t\t\t\t{NULL}']))
 
 class RutabagaStyle(object):
-    def __init__(self, stylesheet, type, normal_props):
+    def __init__(self, stylesheet, selector, normal_props):
         self.stylesheet = stylesheet
 
-        self.type = type
+        self.selector = selector
+        self.type = selector.for_type()
         self.states = OrderedDict()
 
         for s in ('normal', 'focus', 'hover', 'active'):
@@ -154,7 +174,8 @@ class RutabagaStyle(object):
         self.add_state('normal', normal_props)
 
     def __repr__(self):
-        return ('<{0.__class__.__name__} for {0.type}>'.format(self))
+        return ('<{0.__class__.__name__} for {1}>'.format(
+            self, self.selector.key()))
 
     def add_state(self, state, props):
         if state not in state_mapping.keys():
@@ -169,6 +190,7 @@ class RutabagaStyle(object):
 
     c_style_repr = """\
 \t{{"{type}",
+\t\t.selector = {selector},
 \t\t.inherit_from = NULL,
 \t\t.resolved_type = NULL,
 \t\t.properties = {{
@@ -179,6 +201,8 @@ class RutabagaStyle(object):
     def c_repr(self):
         return self.c_style_repr.format(
             type=self.type,
+            selector=("NULL" if self.selector.is_plain()
+                else self.selector.c_repr()),
             state_definitions=',\n'.join(
                 [self.states[state].c_repr(state)
                     for state in self.states]))
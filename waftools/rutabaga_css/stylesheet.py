@@ -34,7 +34,8 @@ import sys
 from collections import OrderedDict
 
 from rutabaga_css.parser import *
-from rutabaga_css.style import RutabagaStyle
+from rutabaga_css.style import RutabagaStyle, builtin_props
+from rutabaga_css.selector import *
 from rutabaga_css.font import *
 
 all = ["RutabagaStylesheet"]
@@ -65,9 +66,25 @@ class RutabagaStylesheet(object):
         self.fonts_used = 0
         self.fonts = {}
 
+        self.prop_ids = OrderedDict(
+            (name, i) for (i, (name, _)) in enumerate(builtin_props))
+
         if autoparse:
             self.parse()
 
+    def intern_prop(self, name):
+        if name not in self.prop_ids:
+            self.prop_ids[name] = len(self.prop_ids)
+
+        return self.prop_ids[name]
+
+    def c_prop_id(self, name):
+        idx = self.intern_prop(name)
+
+        if idx < len(builtin_props):
+            return builtin_props[idx][1]
+        return str(idx)
+
     def parse_font_face(self, rule):
         decls = decl_dict(rule.declarations)
 
@@ -115,18 +132,18 @@ class RutabagaStylesheet(object):
                 decls = decl_dict(rule.declarations)
 
                 for s in sel:
-                    if s.find(":") > 0:
-                        s, state = s.split(":", 1)
+                    key = s.key()
 
-                        if s not in self.styles:
-                            self.styles[s] = RutabagaStyle(self, s, [])
+                    if s.state:
+                        if key not in self.styles:
+                            self.styles[key] = RutabagaStyle(self, s, [])
 
                         try:
-                            self.styles[s].add_state(state, decls)
+                            self.styles[key].add_state(s.state, decls)
                         except AttributeError as e:
                             raise ParseError(rule, str(e))
                     else:
-                        self.styles[s] = RutabagaStyle(self, s, decls)
+                        self.styles[key] = RutabagaStyle(self, s, decls)
 
         for (_, s) in self.styles.items():
             s.done_parsing()
@@ -137,73 +154,106 @@ class RutabagaStylesheet(object):
                 sys.exit(1)
 
     def parse_selector(self, selector):
-        def pop():         return selector.pop() if selector else None
-        def peek(n=1):     return selector[-n] if selector else None
+        # returns one RutabagaSelector per comma-separated selector.
+        # supported: type selectors (optionally namespaced with `ns|type`
+        # or sub-typed with `type::sub`), `*`, `.class`, `#id`, a trailing
+        # `:state`, and descendant combinators (whitespace).
+
         def is_comma(tok): return tok.type == 'DELIM' and tok.value == ','
         def bail(tok):
             raise ParseError(tok, 'unexpected "{0}"'.format(tok.type))
 
+        toks = list(selector)
         ret = []
 
+        def pop():     return toks.pop(0) if toks else None
+        def peek(n=0): return toks[n] if len(toks) > n else None
+
+        def expect_ident(after):
+            tok = pop()
+            if not tok or tok.type != 'IDENT':
+                bail(tok or after)
+            return tok.value
+
+        def qualify(ns, name):
+            if ns:
+                return ns.namespace + "." + name
+            return name
+
+        compounds = []
+        compound = None
+
         while True:
             tok = pop()
-            if not tok:
-                return ret
 
-            if is_comma(tok):
-                continue
+            if not tok or is_comma(tok):
+                if compound:
+                    compounds.append(compound)
+                if not compounds:
+                    if tok:
+                        bail(tok)
+                    return ret
 
-            if tok.type != "IDENT":
-                bail(tok)
+                ret.append(RutabagaSelector(compounds))
+                compounds = []
+                compound = None
 
-            ns = self.in_namespace
-            val = tok.value
+                if not tok:
+                    return ret
+                continue
 
-            while True:
-                ptok = peek()
+            if tok.type == 'S':
+                if compound:
+                    compounds.append(compound)
+                    compound = None
+                continue
 
-                if not ptok or is_comma(ptok):
-                    if ns:
-                        ret.append(ns.namespace + "." + val.lstrip())
-                    else:
-                        ret.append(val.lstrip())
-                    break
-                elif ptok.type == 'IDENT':
-                    val = pop().value + val
+            if not compound:
+                compound = RutabagaCompound()
+            elif compound.state:
+                # states are only allowed at the very end of a selector
+                bail(tok)
 
-                elif ptok.type == 'DELIM' and ptok.value == '|':
-                    # namespace
-                    pop()
-                    ns = self.namespaces[pop().value]
+            if tok.type == 'IDENT':
+                if compound.type or compound.classes or compound.id:
+                    bail(tok)
 
-                elif ptok.type == 'DELIM' and ptok.value == '.':
-                    pop()
-                    val = "." + val
+                ns = self.in_namespace
+                name = tok.value
 
-                elif ptok.type == ':':
+                ptok = peek()
+                if ptok and ptok.type == 'DELIM' and ptok.value == '|':
+                    pop()
+                    ns = self.namespaces[name]
+                    name = expect_ident(ptok)
+
+                # we treat `selector::pseudo` as being convenience syntax
+                # for the `selector.pseudo` type
+                while peek() and peek().type == ':' \
+                        and peek(1) and peek(1).type == ':':
+                    ptok = pop()
                     pop()
-                    ptok = peek()
+                    name += "." + expect_ident(ptok)
 
-                    if ptok.type == ':':
-                        # we treat `selector::pseudo` as being
-                        # convenience syntax for `selector.pseudo`
+                compound.type = qualify(ns, name)
 
-                        pop()
-                        ptok = peek()
+            elif tok.type == 'DELIM' and tok.value == '*':
+                if compound.type or compound.classes or compound.id:
+                    bail(tok)
 
-                        if ptok.type != 'IDENT':
-                            bail(ptok)
+            elif tok.type == 'DELIM' and tok.value == '.':
+                compound.classes.append(expect_ident(tok))
 
-                        val = pop().value + "." + val
-                    else:
-                        val = ":" + val
+            elif tok.type == 'HASH':
+                if compound.id:
+                    bail(tok)
+                compound.id = tok.value[1:]
 
-                elif ptok.type == 'S':
-                    pop()
-                    val = " " + val
+            elif tok.type == ':':
+                compound.state = expect_ident(tok)
 
-                else:
-                    bail(ptok)
+            else:
+                bail(tok)
 
     c_include_tpl = '#include "{header}"'
 
@@ -220,6 +270,17 @@ class RutabagaStylesheet(object):
 {style_structs}
 }};"""
 
+    c_prop_names_tpl = """\
+{{
+{names}
+}};"""
+
+    def c_prop_names(self):
+        return self.c_prop_names_tpl.format(
+            names=",\n".join(
+                ['\t"{0}"'.format(name) for name in self.prop_ids]
+                    + ["\tNULL"]))
+
     def c_repr(self, var_name):
         return self.c_repr_tpl.format(
             var_name=var_name,